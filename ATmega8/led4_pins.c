@@ -159,8 +159,8 @@ const unsigned char ledfont_alpha[]={		//led font, for common anode
 	0x79,								//'e'
 	0x71,								//'f'
 	0x6f,								//'g'
-	0x07,								//'h'
-	0x74,								//'i'
+	0x74,								//'h'
+	0x04,								//'i'
 	0x0e,								//'j'
 	0x00,								//'k'
 	0x38,								//'l'
@@ -173,7 +173,7 @@ const unsigned char ledfont_alpha[]={		//led font, for common anode
     0x6d,								//'s'
     0x00,								//'t'
     0x1c,								//'u'
-    0x00,								//'v'
+    0x1c,								//'v', as 'u'
     0x00,								//'w'
     0x00,								//'x'
     0x6e,								//'y'
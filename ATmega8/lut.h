@@ -0,0 +1,75 @@
+/*
+ * File:   lut.h
+ *
+ * tick -> mpsx10 table in flash, in place of the divide in ticks2vq() (CHRONO_LUT)
+ * defines the table: included once, after F_CPU, CHRONO_DISTANCE and <avr/pgmspace.h>
+ */
+
+#ifndef LUT_H
+#define	LUT_H
+
+//tick -> mpsx10 table in flash, built by the compiler for the compiled-in CHRONO_DISTANCE, F_CPU
+//pseudo-log spacing: LUT_OCTS octaves of 1x ticks from 2^LUT_O0, 32 entries per octave
+//entry j of octave o is the velocity at (32 + j) * 2^o / 32 ticks, rounded. in between: linear interpolation, one multiply
+//error against exact division, all 1x ticks in range (1, 4, 8, 16Mhz; 50.0 .. 300.0mm), host test test/lut_test.c:
+//at most 1 count + 0.023% of mpsx10 -> well under the 1-tick resolution of the measurement itself (0.2% at 1000m/s, 4Mhz)
+//mpsx10 resolution only: ticks2vq() returns the entry with no fraction bits, so ft/s, energy and pf round off it
+#define LUT_K					(CHRONO_DISTANCE * 1000ul * (F_CPU / 1000000ul))	//cfg_kmps at the compiled-in distance
+#define LUT_OCTS				8			//octaves -> a 256:1 velocity range. 257 entries, 514 bytes of flash
+//first octave: the fastest tabulated shot, LUT_K >> LUT_O0, has to fit in 16 bits
+#if   (LUT_K >> 5) <= 0xffff
+#define LUT_O0					5
+#elif (LUT_K >> 6) <= 0xffff
+#define LUT_O0					6
+#elif (LUT_K >> 7) <= 0xffff
+#define LUT_O0					7
+#elif (LUT_K >> 8) <= 0xffff
+#define LUT_O0					8
+#elif (LUT_K >> 9) <= 0xffff
+#define LUT_O0					9
+#elif (LUT_K >> 10) <= 0xffff
+#define LUT_O0					10
+#elif (LUT_K >> 11) <= 0xffff
+#define LUT_O0					11
+#elif (LUT_K >> 12) <= 0xffff
+#define LUT_O0					12
+#else
+#error CHRONO_LUT: CHRONO_DISTANCE * F_CPU out of range
+#endif
+#define LUT_TMIN				(1ul << LUT_O0)	//fastest tabulated shot, 1x ticks
+#define LUT_TMAX				(1ul << (LUT_O0 + LUT_OCTS))	//slowest tabulated shot (excluded), 1x ticks
+
+#define LUT_T(o, j)				((32ull + (j)) << (o))				//ticks of entry j of octave o, x32
+#define LUT_V(o, j)				((LUT_K * 32ull + LUT_T(o, j) / 2) / LUT_T(o, j))	//velocity there, rounded
+#define LUT_OCT(o)				LUT_V(o, 0), LUT_V(o, 1), LUT_V(o, 2), LUT_V(o, 3), LUT_V(o, 4), LUT_V(o, 5), LUT_V(o, 6), LUT_V(o, 7), \
+								LUT_V(o, 8), LUT_V(o, 9), LUT_V(o,10), LUT_V(o,11), LUT_V(o,12), LUT_V(o,13), LUT_V(o,14), LUT_V(o,15), \
+								LUT_V(o,16), LUT_V(o,17), LUT_V(o,18), LUT_V(o,19), LUT_V(o,20), LUT_V(o,21), LUT_V(o,22), LUT_V(o,23), \
+								LUT_V(o,24), LUT_V(o,25), LUT_V(o,26), LUT_V(o,27), LUT_V(o,28), LUT_V(o,29), LUT_V(o,30), LUT_V(o,31)
+
+const uint16_t lut_mpsx10[] PROGMEM = {
+	LUT_OCT(LUT_O0 + 0), LUT_OCT(LUT_O0 + 1), LUT_OCT(LUT_O0 + 2), LUT_OCT(LUT_O0 + 3),
+	LUT_OCT(LUT_O0 + 4), LUT_OCT(LUT_O0 + 5), LUT_OCT(LUT_O0 + 6), LUT_OCT(LUT_O0 + 7),
+	LUT_V(LUT_O0 + 8, 0)					//end of the last octave
+};
+
+//convert 1x ticks to mpsx10 from the table. LUT_TMIN <= ticks < LUT_TMAX
+//ticks are scaled so that the first octave starts at bit 15, then shifted down an octave at a time
+//-> m = 1jjjjjff ffffffff: segment j, 10 bits of fraction
+uint16_t lut_ticks2mpsx10(uint32_t ticks) {
+	uint8_t oct = 0;
+	uint16_t m, v0, v1;
+	const uint16_t *p;
+
+#if LUT_O0 <= 15
+	ticks <<= 15 - LUT_O0;
+#else
+	ticks >>= LUT_O0 - 15;
+#endif
+	while (ticks > 0xffff) {ticks >>= 1; oct += 1;}
+	m = ticks;
+	p = &lut_mpsx10[oct * 32 + ((m >> 10) & 0x1f)];
+	v0 = pgm_read_word(p); v1 = pgm_read_word(p + 1);
+	return v0 - (uint16_t) (((uint32_t) (v0 - v1) * (m & 0x3ff) + 0x200) >> 10);
+}
+
+#endif	/* LUT_H */
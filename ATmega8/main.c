@@ -5,21 +5,64 @@
 #include "gpio.h"
 #include "delay.h"							//we use software delays
 #include "led4_pins.h"						//we use 4-digit led display - different wiring!
+#include "bcd.h"							//binary to bcd conversion
+#include "tstamp.h"							//extended time stamps
+#include "stats.h"							//shot-string statistics
+#include "vq.h"								//velocity in fixed point
+#include <avr/eeprom.h>						//configuration in eeprom
+#include <avr/pgmspace.h>					//velocity table in flash
 
 //hardware configuration
 #define CHRONO_PORT				PORTB
 #define CHRONO_DDR				DDRB
-#define CHRONO					(1<<0)		//ICP1 on PB0
+#define CHRONO					(1<<0)		//ICP1 on PB0 -> gate 1 (start)
+#define CHRONO2_PORT			PORTD
+#define CHRONO2_DDR				DDRD
+#define CHRONO2					(1<<7)		//AIN1 on PD7 -> gate 2 (stop), through the analog comparator into input capture (ACIC)
+											//INT0/PD2 is not an option on this board: it drives SEGF
 
 //status indicators - active high
 //status: DP of the first digit.
 //normally off; ON when the first signal arrives, off when the 2nd signal arrives.
-//if the indicator remains on, needs to reset the chrono
-#define CHRONO_PS				TMR1PS_1x	//tmr1 prescaler
+//if the 2nd signal never arrives, the indicator goes off after CHRONO_TIMEOUT tmr1 overflows and the chrono re-arms by itself
+//CHRONO_PS, CHRONO_DISTANCE, CHRONO_TRIGGER, CHRONO_UNIT, CHRONO_MASS, CHRONO_SKEW2 and OSCCAL_CAL are defaults: the eeprom copy (set from the console) wins
+#define CHRONO_PS				TMR1PS_1x	//tmr1 prescaler - starting point with CHRONO_AUTORANGE
+//#define CHRONO_AUTORANGE					//define CHRONO_AUTORANGE to pick the tmr1 prescaler from recent intervals (TMR1PS_1x..TMR1PS_1024x)
 #define CHRONO_DISTANCE			1234		//chrono sensor distance, x10mm (1234=123.4mm)
-#define CHRONO_TRIGGER			RISING		//input capture on rising / falling edge
+#define CHRONO_TRIGGER			RISING		//input capture on rising / falling edge - the leading edge of a gate's shadow pulse
+//#define CHRONO_PULSE						//define CHRONO_PULSE to time stamp the trailing edge of each gate too -> shadow duration / projectile length
+											//projectile must be shorter than the gate distance
+#define CHRONO_PULSE_TOL		4			//gate pulse widths differing by more than 1/CHRONO_PULSE_TOL flag a bad trigger
+#define CHRONO_UNIT				UNIT_TICKS	//value on the display: UNIT_TICKS / _USX10 / _MPSX10 / _FPSX10 / _RPMX10 / _LENX10 / _JX10 / _FTLBFX10 / _PFX10
+#define CHRONO_MASS				1470		//projectile mass, grains x10 (1470=147.0gr) -> energy / power factor
+//#define CHRONO_CONSOLE					//define CHRONO_CONSOLE for a setup console on the usart at power-up, CFG_BAUD 8n1
+											//RXD/TXD (PD0/PD1) drive display segments -> the console only runs before the display starts
+#define CFG_BAUD				9600		//console baud rate, U2X
+#define CFG_WAIT				2000		//ms to wait for a key at power-up before the chrono starts
 #define CHRONO_DP							//define CHRONO_DP if you want to show decimal point on digit 3/4.
-//#define FAST_MATH							//using faster math so the code runs at 1Mhz
+//#define CHRONO_LUT						//define CHRONO_LUT for a flash table in place of the divide in ticks2mpsx10() -> 1Mhz battery builds
+											//mpsx10 resolution only: ft/s, energy and pf are worked out off the table's whole mpsx10
+											//compiled-in CHRONO_DISTANCE only: a distance set from the console falls back to the divide
+//#define CHRONO_BENCH						//define CHRONO_BENCH for console command b: cycles of each conversion / bcd strategy, timed with tmr1. pulls in soft float
+//#define CHRONO_TS48						//define CHRONO_TS48 for 48-bit timestamps (32-bit overflow count) so long strings never wrap
+#define CHRONO_RING				8			//capture ring size, in records. power of 2, up to 128
+#define CHRONO_TIMEOUT			8			//tmr1 overflows to wait for gate 2 before the shot is a miss. 8 = 131ms@4Mhz, 1x prescaler
+//#define CHRONO_ICNC						//define CHRONO_ICNC to enable the input capture noise canceller: 4 equal samples, same 4-clock delay on both gates
+#define CHRONO_SKEW2			2			//gate 2 lag behind gate 1, cpu clocks: the analog comparator delay (500ns@5v, 750ns@2.7v). taken off gate 2
+#define CHRONO_MIN_US			20			//shortest plausible gate 1 -> gate 2 interval, us. 20us = 6170m/s over 123.4mm
+#define CHRONO_MAX_US			100000ul	//longest plausible gate 1 -> gate 2 interval, us. 100ms = 1.2m/s over 123.4mm
+#define CHRONO_HOLDOFF_US		1000		//gate 1 edges within this long of the last gate 2 edge are ignored, us
+//#define CHRONO_LEAN						//define CHRONO_LEAN for a minimal capture isr: ICR1 + overflow count only, pairing / filtering in the main loop
+#define CHRONO_CAPS				16			//raw edge ring size with CHRONO_LEAN, in edges. power of 2, up to 128
+//#define CHRONO_BURST						//define CHRONO_BURST for full-auto strings: time stamps only while firing, conversion / display afterwards
+#define CHRONO_BURST_SIZE		40			//shots per string, 8 bytes each (16 bytes with CHRONO_TS48 -> reduce)
+#define CHRONO_BURST_GAP_MS		500			//ms without a shot that end the string
+#define CHRONO_BURST_SHOW_MS	1000		//ms each result stays on the display
+//#define CHRONO_STATS						//define CHRONO_STATS for shot-string statistics: n / avg / sd / es / lo / hi replayed on the display after the last shot of a string
+											//of the value on display (cfg.unit). not with CHRONO_BURST: it replays its own string
+#define CHRONO_STRING			10			//shots per string, up to STATS_NMAX
+#define CHRONO_STATS_SHOW_MS	1000		//ms each label / value stays on the display
+											//_MS times are kept in tmr1 overflows: 16ms@4Mhz, 1x prescaler .. 16.8s, 1024x, at least one
 
 #define OSCCAL_CAL				0xbd		//0xbd@1mhz, 0xbf@2mhz, 0xbd@4Mhz, 0xcd@8Mhz. Device and frequency specific (b3 b2 ae ae)
 
@@ -30,6 +73,9 @@
 //end hardware configuration
 
 //global defines
+#if defined(CHRONO_BURST)
+#undef CHRONO_STATS							//burst mode replays its own string
+#endif
 #define RISING					0
 #define FALLING					1
 #define TMR1PS_1x				0x01		//0x01->1x prescaler
@@ -37,86 +83,825 @@
 #define TMR1PS_64x				0x03		//0x03->64x prescaler
 #define TMR1PS_256x				0x04		//0x04->256x prescaler
 #define TMR1PS_1024x			0x05		//0x05->1024x prescaler
+#define CHRONO_GATE1			1			//start gate, on ICP1
+#define CHRONO_GATE2			2			//stop gate, on AIN1 via the analog comparator
+#define CHRONO_IDLE				0			//waiting for gate 1 - ready to fire
+#define CHRONO_ARMED			1			//gate 1 seen, waiting for gate 2 - timeout running
+#define CHRONO_COMPLETE			2			//gate 2 seen, shot recorded - gate 1 held off for CHRONO_HOLDOFF_US
+#define CHRONO_LEAD				(cfg.trigger)	//leading edge of a shadow pulse, at the pin
+#define CHRONO_TRAIL			(cfg.trigger ^ 1)	//trailing edge of a shadow pulse, at the pin
+#define CHRONO_F_WIDTH			0x01		//record flag: gate 1 / gate 2 pulse widths disagree -> suspect trigger
+#define CHRONO_STEP(gate, edge)	((((gate) == CHRONO_GATE2)?0x02:0x00) | (((edge) == CHRONO_TRAIL)?0x01:0x00))	//capture unit setting, 0..3
+#define UNIT_TICKS				0			//display unit: raw ticks, last 4 digits
+#define UNIT_USX10				1			//display unit: us x 10
+#define UNIT_MPSX10				2			//display unit: m/s x 10
+#define UNIT_FPSX10				3			//display unit: ft/s x 10
+#define UNIT_RPMX10				4			//display unit: cyclic rate, rpm x 10
+#define UNIT_LENX10				5			//display unit: projectile length, mm x 10. needs CHRONO_PULSE
+#define UNIT_JX10				6			//display unit: muzzle energy, J x 10
+#define UNIT_FTLBFX10			7			//display unit: muzzle energy, ft.lbf x 10
+#define UNIT_PFX10				8			//display unit: power factor x 10 (gr * fps / 1000)
+#define CFG_VER					3			//eeprom layout version. bump when chrono_cfg_t changes
+#define CHRONO_TAG_TIMEOUT		0x80		//raw edge tag: not an edge, gate 2 timed out. TOV1 (0x04) marks a pending overflow
 
 //led indicators - active high
 #define LED_ON(LEDs)			IO_SET(LED_PORT, LEDs)
 #define LED_OFF(LEDs)			IO_CLR(LED_PORT, LEDs)
 
+//extended timestamp: tmr1 overflow count in the upper bits, ICR1 in the lower 16 bits
+#if defined(CHRONO_TS48)
+typedef uint64_t chrono_ts_t;				//48-bit timestamp: 32-bit overflow count + 16-bit ICR1
+#else
+typedef uint32_t chrono_ts_t;				//32-bit timestamp: 16-bit overflow count + 16-bit ICR1
+#endif
+
+//capture record, passed from the capture isr to the main loop
+typedef struct {
+	uint32_t ticks;							//ticks elapsed between start / end
+	uint32_t period;						//ticks since the start of the previous shot. 0=first shot / unknown. modulo 2^32 without CHRONO_TS48
+	uint8_t ps;								//tmr1 prescaler (TMR1PS_x) the record was taken with
+	uint16_t w1, w2;						//gate 1 / gate 2 shadow pulse widths, ticks. 0 without CHRONO_PULSE
+} chrono_rec_t;
+
+//everything that follows the tmr1 prescaler, in its ticks / overflows. worked out by chrono_limits()
+typedef struct {
+	uint32_t min, max;						//plausible interval window, ticks
+	uint32_t hold;							//re-arm holdoff, ticks
+	uint8_t skew;							//gate 2 lag behind gate 1 (cfg.skew), ticks
+	uint8_t gap;							//CHRONO_BURST_GAP_MS, overflows
+	uint8_t dwell;							//CHRONO_BURST_SHOW_MS / CHRONO_STATS_SHOW_MS, overflows
+} chrono_lim_t;
+
+//run time configuration, kept in eeprom
+typedef struct {
+	uint8_t ver;							//CFG_VER
+	uint16_t distance;						//sensor distance, x10mm
+	uint8_t ps;								//tmr1 prescaler, TMR1PS_x
+	uint8_t trigger;						//leading edge at the pins: RISING / FALLING
+	uint8_t unit;							//display unit, UNIT_x
+	uint8_t osccal;							//OSCCAL, applied at power-up
+	uint16_t mass;							//projectile mass, grains x10
+	uint8_t skew;							//gate 2 lag behind gate 1, cpu clocks
+	uint8_t crc;							//crc-8 of the bytes above
+} chrono_cfg_t;
+
 //global variables
-volatile uint32_t chrono_ticks=0;			//ticks elapsed between start / end
-volatile char chrono_available=0;			//data availability flag. 1=new data available, 0=no new data available
-volatile uint32_t ticks=0;					//32-bit ticks
+chrono_cfg_t cfg;							//configuration in use
+chrono_cfg_t cfg_ee EEMEM;					//configuration in eeprom
+uint32_t cfg_kmps;							//distance * 1000 * ticks per us: mpsx10 = cfg_kmps / ticks, at the 1x prescaler
+uint32_t cfg_kq;							//cfg_kmps << cfg_vsh: vq = cfg_kq / ticks is mpsx10 in Q(cfg_vsh) fixed point
+uint8_t cfg_vsh;							//fraction bits of vq, 1..16: as many as cfg_kq holds
+//single-producer (capture isr) / single-consumer (main loop) ring of capture records
+//free-running 8-bit indices: chrono_head is written by the isr only, chrono_tail by the main loop only
+volatile chrono_rec_t chrono_ring[CHRONO_RING];	//capture records
+volatile uint8_t chrono_head=0;				//next record to be written by the isr
+volatile uint8_t chrono_tail=0;				//next record to be read by the main loop
+volatile uint8_t chrono_ovf=0;				//records dropped because the ring was full
+volatile uint8_t chrono_state=CHRONO_IDLE;	//measurement state: CHRONO_IDLE -> CHRONO_ARMED -> CHRONO_COMPLETE
+volatile uint8_t chrono_timer=0;			//tmr1 overflows since gate 1 fired
+volatile uint8_t chrono_misses=0;			//shots abandoned because gate 2 never fired
+volatile char chrono_prev_ok=0;				//1=the previous shot's time stamp is valid for the next period
+volatile uint8_t chrono_edge;				//edge the input capture unit is set for, at the pin: RISING / FALLING
+volatile uint8_t chrono_rejects=0;			//edges rejected by the plausibility / holdoff filter
+volatile chrono_lim_t chrono_lim;			//limits of the running prescaler
+volatile chrono_ts_t ticks=0;				//extended ticks, advanced by 0x10000 on each tmr1 overflow
+volatile uint8_t ovf8=0;					//tmr1 overflows, 8-bit: a time base the main loop can read atomically
+#if defined(CHRONO_STATS)
+#if CHRONO_STRING > STATS_NMAX
+#error "CHRONO_STRING: up to STATS_NMAX shots per string"
+#endif
+stats_t stats;								//statistics of the current string. main loop only
+#endif
+
+#if defined(CHRONO_LEAN)
+#if defined(CHRONO_BURST)
+#error "CHRONO_LEAN and CHRONO_BURST are exclusive: burst mode already defers the conversions"
+#endif
+//raw edge, passed from the capture isr to the main loop
+typedef struct {
+	uint16_t icr;							//ICR1
+	chrono_ts_t msw;						//ticks at the capture: not yet corrected for a pending TOV1
+	uint8_t tag;							//CHRONO_STEP() the capture unit was set for | TOV1 pending, or CHRONO_TAG_TIMEOUT
+} chrono_cap_t;
+
+volatile chrono_cap_t cap_ring[CHRONO_CAPS];	//raw edges
+volatile uint8_t cap_head=0;				//next edge to be written by the isrs
+volatile uint8_t cap_tail=0;				//next edge to be read by the main loop
+volatile uint8_t cap_lost=0;				//edges dropped because the ring was full
+volatile uint8_t chrono_step=0;				//CHRONO_STEP() the capture unit is set for now
+
+//capture unit setting for each step: gate mux, ICES1 (gate 2 inverted through the comparator), and the step after it
+const uint8_t chrono_acsr[4]={(1<<ACBG), (1<<ACBG), (1<<ACBG) | (1<<ACIC), (1<<ACBG) | (1<<ACIC)};
+uint8_t chrono_ices[4];						//lead, trail, trail, lead: from cfg.trigger, in chrono_init()
+#if defined(CHRONO_PULSE)
+const uint8_t chrono_next[4]={1, 2, 3, 0};	//gate 1 lead -> gate 1 trail -> gate 2 lead -> gate 2 trail
+#else
+const uint8_t chrono_next[4]={2, 2, 0, 0};	//gate 1 lead -> gate 2 lead. 1 / 3 not used
+#endif
+#endif
+
+#if defined(CHRONO_BURST)
+//burst recording: raw gate edges of a string, processed once the string has ended
+typedef struct {
+	chrono_ts_t start;						//gate 1 time stamp
+	chrono_ts_t end;						//gate 2 time stamp
+} chrono_burst_t;
+
+volatile chrono_burst_t burst[CHRONO_BURST_SIZE];	//raw time stamps, written by the capture isr
+volatile uint8_t burst_n=0;					//shots in burst[]
+volatile uint8_t burst_idle=0;				//tmr1 overflows since the last shot
+volatile char burst_done=0;					//1=string ended, burst[] belongs to the main loop until cleared
+uint16_t burst_v[CHRONO_BURST_SIZE];		//results: velocity, mpsx10
+uint16_t burst_r[CHRONO_BURST_SIZE];		//results: cyclic rate to the previous shot, rpmx10. 0 for the first shot
+#endif
+
+//the gate that produced the edge in ICR1 is the one routed to the input capture unit: ACIC is the hardware tag
+#define chrono_gate()			((ACSR & (1<<ACIC))?CHRONO_GATE2:CHRONO_GATE1)
+
+#if defined(CHRONO_LEAN)
+//set the capture unit for a step, from the tables. isr context, or interrupts off
+static inline void chrono_hw(uint8_t step) {
+	ACSR = chrono_acsr[step];				//gate mux
+	TCCR1B = (TCCR1B & ~0x40) | chrono_ices[step];	//ICES1
+	TIFR = (1<<ICF1);						//changing ACIC / ICES1 may set ICF1 -> clear it. write, not |=, to leave TOV1 alone
+	chrono_step = step;
+}
+
+//the capture isr has moved the capture unit on already. called from the main loop when a filter wants a different step:
+//move it, unless a newer edge has been captured meanwhile -> the hardware has moved on since, and its edges are in the ring
+static inline void chrono_sel(uint8_t gate, uint8_t edge) {
+	uint8_t step = CHRONO_STEP(gate, edge);
+
+	di();
+	if ((chrono_step != step) && (cap_head == cap_tail)) chrono_hw(step);
+	ei();
+}
+#define chrono_keep(gate, edge)	chrono_sel(gate, edge)	//rejected edge: the isr has moved on -> move it back
+#define chrono_busy()			(chrono_step || (cap_head != cap_tail))	//shot under way, or edges not yet processed
+#else
+//route a gate to the input capture unit, and set the edge (RISING / FALLING, at the pin) it captures on
+//gate 1: ICP1 pin directly (ACIC=0)
+//gate 2: analog comparator output (ACIC=1). bandgap on the positive input, AIN1 on the negative input
+//-> the comparator output is the inverted AIN1 pin, so is the edge
+static inline void chrono_sel(uint8_t gate, uint8_t edge) {
+	chrono_edge = edge;
+	if (gate == CHRONO_GATE1) ACSR &=~(1<<ACIC);
+	else {ACSR |= (1<<ACIC); edge ^= 1;}	//edge on ACO is the opposite of the edge on AIN1
+	if (edge == RISING) TCCR1B |= 0x40;		//ICES1=1->rising edge
+	else TCCR1B &=~0x40;					//ICES1=0->falling edge
+	TIFR = (1<<ICF1);						//changing ACIC / ICES1 may set ICF1 -> clear it. write, not |=, to leave TOV1 alone
+}
+#define chrono_keep(gate, edge)				//rejected edge: the capture unit is still set for it
+#define chrono_busy()			(chrono_state == CHRONO_ARMED)	//shot under way
+#endif
+
+//shot abandoned: gate 2 never fired
+static inline void chrono_miss(void) {
+	chrono_state = CHRONO_IDLE;
+	chrono_misses += 1;
+	lRAM[0] &=~0x80;						//turn off the decimal point for the first digit
+}
 
 //tmr1 overflow isr
 ISR(TIMER1_OVF_vect) {
 	//clear the flag - done automatically
 	ticks += 0x10000ul;						//tmr1 is 16-bit wide
+	ovf8 += 1;
+
+#if defined(CHRONO_BURST)
+	//string ends when no shot has arrived for CHRONO_BURST_GAP_MS
+	if (burst_n && !burst_done && (++burst_idle >= chrono_lim.gap)) burst_done = 1;
+#endif
+
+#if defined(CHRONO_LEAN)
+	//timeout: capture unit past gate 1 for too long -> back to gate 1, and queue the miss behind the edges it follows
+	if (chrono_step && (++chrono_timer >= CHRONO_TIMEOUT)) {
+		uint8_t head = cap_head;
+
+		chrono_hw(CHRONO_STEP(CHRONO_GATE1, CHRONO_LEAD));
+		if ((uint8_t) (head - cap_tail) >= CHRONO_CAPS) {cap_lost += 1; return;}
+		cap_ring[head & (CHRONO_CAPS - 1)].tag = CHRONO_TAG_TIMEOUT;
+		cap_head = head + 1;
+	}
+#else
+	//timeout: gate 2 missed -> abort the shot, count it as a miss and re-arm on gate 1. no reset needed
+	if ((chrono_state == CHRONO_ARMED) && (++chrono_timer >= CHRONO_TIMEOUT)) {
+		chrono_sel(CHRONO_GATE1, CHRONO_LEAD);	//back to gate 1
+		chrono_miss();
+	}
+#endif
 }
 
-//tmr1 capture isr
-ISR(TIMER1_CAPT_vect) {
-	static uint32_t chrono_start, chrono_end;
-	static char chrono_ch=0;				//chrono input channel. 0=>put ICR1 into start, 1->put ICR1 input end
+//form the extended timestamp of the value in ICR1. called from TIMER1_CAPT_vect only
+//TIMER1_CAPT_vect has priority over TIMER1_OVF_vect -> a pending TOV1 has not been counted in ticks yet: TS_EXTEND()
+//assumes the capture isr is serviced within 0x8000 ticks of the edge. host test: test/tstamp_test.c
+static inline chrono_ts_t chrono_stamp(void) {
+	uint16_t icr = ICR1;					//read ICR1 first
+	chrono_ts_t msw = ticks;				//then the overflow count
+
+	return TS_EXTEND(msw, icr, TIFR & (1<<TOV1));
+}
+
+//push a record into the capture ring. called from the capture isr only. constant time
+//the record is written before chrono_head is advanced, so the main loop never sees a partial record
+static inline void chrono_push(uint32_t ticks, uint32_t period, uint16_t w1, uint16_t w2) {
+	uint8_t head = chrono_head;
+
+	if ((uint8_t) (head - chrono_tail) >= CHRONO_RING) {chrono_ovf += 1; return;}	//ring full -> count the loss
+	chrono_ring[head & (CHRONO_RING - 1)].ticks = ticks;
+	chrono_ring[head & (CHRONO_RING - 1)].period = period;
+	chrono_ring[head & (CHRONO_RING - 1)].ps = TCCR1B & 0x07;	//the prescaler only changes between shots
+	chrono_ring[head & (CHRONO_RING - 1)].w1 = w1;
+	chrono_ring[head & (CHRONO_RING - 1)].w2 = w2;
+	chrono_head = head + 1;					//publish the record
+}
+
+//pop a record from the capture ring. called from the main loop only
+//return 1 if a record is retrieved, 0 if the ring is empty
+char chrono_pop(chrono_rec_t *rec) {
+	uint8_t tail = chrono_tail;
+
+	if (tail == chrono_head) return 0;		//ring empty
+	*rec = chrono_ring[tail & (CHRONO_RING - 1)];
+	chrono_tail = tail + 1;					//release the slot
+	return 1;
+}
+
+#if defined(CHRONO_BURST)
+//record the raw time stamps of a shot. called from the capture isr only. constant time
+//no room, or the previous string not yet processed -> the shot is counted as lost
+static inline void burst_push(chrono_ts_t start, chrono_ts_t end) {
+	uint8_t n = burst_n;
+
+	if (burst_done || (n >= CHRONO_BURST_SIZE)) {chrono_ovf += 1; return;}
+	burst[n].start = start;
+	burst[n].end = end;
+	burst_n = n + 1;
+	burst_idle = 0;							//restart the end-of-string timeout
+	if (n + 1 == CHRONO_BURST_SIZE) burst_done = 1;	//buffer full -> string ends here
+}
+#endif
+
+//process a gate edge: pairing, filtering, state
+//from the capture isr, or from the main loop with CHRONO_LEAN. gate / edge are those the capture unit was set for
+static inline void chrono_proc(chrono_ts_t stamp, uint8_t gate, uint8_t edge) {
+	static chrono_ts_t chrono_start, chrono_end;
+#if !defined(CHRONO_BURST)
+	static chrono_ts_t chrono_prev;			//gate 1 time stamp of the previous shot
+	chrono_ts_t period;
+#endif
+	static uint16_t chrono_w1;				//gate 1 pulse width
+	uint16_t chrono_w2=0;					//gate 2 pulse width
+	uint32_t dt;
 
 	//clear the flag -> done automatically
-	if ((chrono_ch++ & 0x01)==0) {			//ch = 0 right now -> ICR1 to start
-		chrono_start = ticks | ICR1;				//save ICR1 to chrono_start
+	if (gate == CHRONO_GATE2) stamp -= chrono_lim.skew;	//comparator delay: back to the edge at the pin
+	//start / stop is decided by the gate that produced the edge, not by counting edges
+	//a missed or spurious edge cannot swap later pairs
+	//filter: one 32-bit subtract and at most two 32-bit compares per edge
+	//edge sequence: gate 1 lead -> (gate 1 trail) -> gate 2 lead -> (gate 2 trail). trailing edges with CHRONO_PULSE only
+	if (gate == CHRONO_GATE1) {
+#if defined(CHRONO_PULSE)
+		if (edge == CHRONO_TRAIL) {	//gate 1 trailing edge -> shadow duration
+			chrono_w1 = stamp - chrono_start;
+			chrono_sel(CHRONO_GATE2, CHRONO_LEAD);	//now wait for gate 2
+			return;
+		}
+#endif
+		//gate 1 leading edge -> ICR1 to start
+		if (chrono_state == CHRONO_COMPLETE) {
+			dt = stamp - chrono_end;		//time since the last gate 2 edge
+			if (dt < chrono_lim.hold) {			//still in the holdoff -> muzzle blast, flicker
+				chrono_rejects += 1;
+				chrono_keep(CHRONO_GATE1, CHRONO_LEAD);
+				return;
+			}
+		}
+		chrono_start = stamp;				//save extended ICR1 to chrono_start
+		chrono_w1 = 0;
+#if !defined(CHRONO_LEAN)
+		chrono_timer = 0;					//start the timeout. the lean isr does it itself
+#endif
+		chrono_state = CHRONO_ARMED;
+#if defined(CHRONO_PULSE)
+		chrono_sel(CHRONO_GATE1, CHRONO_TRAIL);	//now wait for the end of gate 1's pulse
+#else
+		chrono_sel(CHRONO_GATE2, CHRONO_LEAD);	//now wait for gate 2
+#endif
 		//LED_OFF(LED_START);					//turn off the start led
 		lRAM[0] |= 0x80;					//set the decimal point for the first digit
-	} else {								//ch = 1 right now -> ICR1 to end
-		chrono_end = ticks | ICR1;					//save ICR1 to end
-		chrono_ticks = chrono_end - chrono_start;	//calculate ticks elapsed
-		chrono_available = 1;				//1->new data available
-		//LED_OFF(LED_STOP); 					//turn off the stop led
-		lRAM[0] &=~0x80;					//turn off the decimal point for the first digit
+		return;
+	}
+
+	if (chrono_state != CHRONO_ARMED) {chrono_rejects += 1; return;}	//gate 2 without a gate 1: timed out meanwhile, or lost
+#if defined(CHRONO_PULSE)
+	if (edge == CHRONO_LEAD) {				//gate 2 leading edge -> ICR1 to end
+#endif
+		dt = stamp - chrono_start;			//interval
+		if (dt < chrono_lim.min) {				//too soon -> keep waiting for the real gate 2 edge
+			chrono_rejects += 1;
+			chrono_keep(CHRONO_GATE2, CHRONO_LEAD);
+			return;
+		}
+		if (dt > chrono_lim.max) {				//too late -> not this shot's gate 2: re-arm on gate 1
+			chrono_rejects += 1;
+			chrono_sel(CHRONO_GATE1, CHRONO_LEAD);
+			chrono_state = CHRONO_IDLE;
+			lRAM[0] &=~0x80;				//turn off the decimal point for the first digit
+			return;
+		}
+		chrono_end = stamp;					//save extended ICR1 to end
+#if defined(CHRONO_PULSE)
+		chrono_sel(CHRONO_GATE2, CHRONO_TRAIL);	//now wait for the end of gate 2's pulse. timeout still running
+		return;
 	}
+	chrono_w2 = stamp - chrono_end;			//gate 2 trailing edge -> shadow duration
+#endif
+
+	//shot complete
+	chrono_state = CHRONO_COMPLETE;
+#if defined(CHRONO_BURST)
+	burst_push(chrono_start, chrono_end);	//raw time stamps only, processed after the string
+	(void) chrono_w1; (void) chrono_w2;		//pulse widths not kept in burst mode
+#else
+	//interval since the start of the previous shot, on the same extended time base
+	period = chrono_prev_ok?(chrono_start - chrono_prev):0;
+#if defined(CHRONO_TS48)
+	if (period > 0xfffffffful) period = 0;	//too long ago to fit the record -> unknown
+#endif
+	chrono_prev = chrono_start; chrono_prev_ok = 1;
+	chrono_push(chrono_end - chrono_start, period, chrono_w1, chrono_w2);	//ticks elapsed, to the main loop
+#endif
+	chrono_sel(CHRONO_GATE1, CHRONO_LEAD);	//re-arm on gate 1
+	//LED_OFF(LED_STOP); 					//turn off the stop led
+	lRAM[0] &=~0x80;						//turn off the decimal point for the first digit
 }
 
-//conversion routines
-//converting ticks to us
-uint32_t ticks2usx10(uint32_t ticks) {
-	switch (TCCR1B & 0x07) {
-		case TMR1PS_1x: ticks *= 1; break;	//1x prescaler
-		case TMR1PS_8x: ticks *= 8; break;	//8x prescaler
-		case TMR1PS_64x: ticks *= 64; break;
-		case TMR1PS_256x: ticks *= 256; break;
-		case TMR1PS_1024x: ticks *= 1024; break;
+#if defined(CHRONO_LEAN)
+//tmr1 capture isr, minimal: latch ICR1 and the overflow count, move the capture unit to the next step, nothing else
+//the display, the 32-bit math and the state machine run in the main loop (chrono_edges())
+//
+//minimum edge spacing: two edges on different gates are resolved if they are at least the longest hold-off of this
+//isr (TIMER1_OVF_vect, the di() sections in chrono_sel() and the CHRONO_AUTORANGE prescaler switch) plus the isr's
+//own path from the edge to "next step" (ACSR, ICES1, ICF1) apart. the same holds for the trailing edges with CHRONO_PULSE
+//no figure is given: it has not been counted from this build's listing or measured. to measure it, wire DEBUG_PIN to
+//ICP1 and AIN1 and shorten the delay() between its pulses down to the first miss (cap_lost, chrono_rejects)
+ISR(TIMER1_CAPT_vect) {
+	uint16_t icr = ICR1;					//first: the next capture may overwrite it
+	uint8_t head = cap_head;
+	uint8_t step = chrono_step;
+	volatile chrono_cap_t *cap;
+
+	//clear the flag -> done automatically
+	if ((uint8_t) (head - cap_tail) >= CHRONO_CAPS) {cap_lost += 1; return;}	//ring full -> drop the edge, stay on this step
+	cap = &cap_ring[head & (CHRONO_CAPS - 1)];
+	cap->icr = icr;
+	cap->msw = ticks;
+	cap->tag = step | (TIFR & (1<<TOV1));	//overflow pending at the capture? sorted out in the main loop
+	chrono_hw(chrono_next[step]);			//on to the next edge
+	chrono_timer = 0;						//(re)start the timeout
+	cap_head = head + 1;					//publish the edge
+}
+
+//pair up the raw edges from the capture isr. called from the main loop, interrupts on
+void chrono_edges(void) {
+	chrono_cap_t cap;
+	chrono_ts_t msw;
+	uint8_t tail;
+
+	while ((tail = cap_tail) != cap_head) {
+		cap = cap_ring[tail & (CHRONO_CAPS - 1)];
+		cap_tail = tail + 1;				//release the slot: chrono_sel() needs to know whether newer edges exist
+		if (cap.tag & CHRONO_TAG_TIMEOUT) {	//gate 2 timed out
+			if (chrono_state == CHRONO_ARMED) chrono_miss();
+			continue;
+		}
+		//extended timestamp, as chrono_stamp()
+		msw = TS_EXTEND(cap.msw, cap.icr, cap.tag & (1<<TOV1));
+		chrono_proc(msw, (cap.tag & 0x02)?CHRONO_GATE2:CHRONO_GATE1, (cap.tag & 0x01)?CHRONO_TRAIL:CHRONO_LEAD);
 	}
-	return ticks / (F_CPU / 1000000ul) * 10;		//return us
+}
+#else
+//tmr1 capture isr
+ISR(TIMER1_CAPT_vect) {
+	chrono_proc(chrono_stamp(), chrono_gate(), chrono_edge);
+}
+#endif
+
+//conversion routines
+//ps is the prescaler the ticks were taken with, not the one tmr1 runs on now
+//the prescaler is folded into the ticks with a shift -> one divide per conversion
+const uint8_t tmr1ps_shift[]={0, 0, 3, 6, 8, 10};	//log2 of the prescaler, indexed by TMR1PS_x. 0=tmr1 stopped
+
+//scale ticks of prescaler ps to 1x ticks. saturates: a saturated interval converts to 0 / full scale anyway
+uint32_t ticks2x1(uint32_t ticks, uint8_t ps) {
+	uint8_t sh = tmr1ps_shift[ps];
+
+	return (ticks > (0xfffffffful >> sh))?0xfffffffful:(ticks << sh);
 }
 
+#if defined(CHRONO_BENCH)
 //convert ticks to mpsx10 using floating point math
-//for demo only, not used -> too slow / bulky
-uint32_t ticks2mpsx10_fp(uint32_t ticks) {
-	//return (float) CHRONO_DISTANCE * 0.001 / ((float) ticks2us(ticks) * 1e-6);
-	//return (float) CHRONO_DISTANCE * 1000.0 * 10.0 / (float) ticks2usx10(ticks);
+//the soft-float reference for CHRONO_BENCH only, not used -> too slow / bulky
+uint32_t ticks2mpsx10_fp(uint32_t ticks, uint8_t ps) {
+	return (float) cfg_kmps / (float) ticks2x1(ticks, ps) + 0.5;
+}
+#endif
+
+#if defined(CHRONO_LUT)
+#include "lut.h"							//tick -> mpsx10 table, for CHRONO_DISTANCE / F_CPU as compiled
+#endif
+
+//velocity in fixed point: vq = mpsx10 * 2^cfg_vsh. the one divide of the conversion pipeline
+//ticks are 1x ticks. the fraction bits let fpsx10 / mpsx10 round off the exact quotient
+uint32_t ticks2vq(uint32_t ticks) {
+#if defined(CHRONO_LUT)
+	//the table holds whole mpsx10: no fraction bits -> the other units carry its rounding (and its 1 count + 0.023%)
+	if ((cfg.distance == CHRONO_DISTANCE) && (ticks >= LUT_TMIN) && (ticks < LUT_TMAX)) return (uint32_t) lut_ticks2mpsx10(ticks) << cfg_vsh;
+#endif
+	return cfg_kq / ticks;					//distance constant from cfg_apply()
+}
+
+//convert ticks to meters per second x 10 (mpsx10) using integer math, rounded
+uint32_t ticks2mpsx10(uint32_t ticks, uint8_t ps) {
+	return VQ_ROUND(ticks2vq(ticks2x1(ticks, ps)), cfg_vsh);
+}
+
+//muzzle energy and power factor, off vq and the projectile mass cfg.mass (grains x10). see vq.h
+uint32_t vq2energy(uint32_t vq, uint32_t ke) {
+	if (vq > VQ_MAX(cfg_vsh)) vq = VQ_MAX(cfg_vsh);
+	return VQ_ENERGY(vq, cfg_vsh, cfg.mass, ke);
+}
+
+uint32_t vq2pfx10(uint32_t vq) {
+	if (vq > VQ_MAX(cfg_vsh)) vq = VQ_MAX(cfg_vsh);
+	return VQ_PFX10(vq, cfg_vsh, cfg.mass);
+}
+
+//conversion pipeline: the units of a shot off one divide, ticks2vq()
+//only the units flagged in mask (UNIT_M(UNIT_x)) are worked out -> the display pays for the unit it shows
+//us: constant divisor, no divide. ft/s, energy, pf: multiplies off vq, not off the rounded m/s
+//each unit is rounded once, from vq / the ticks -> no truncation is carried from one unit into the next
+#define UNIT_M(unit)			(1u << (unit))	//mask bit of a unit
+#define UNIT_M_V				(UNIT_M(UNIT_MPSX10) | UNIT_M(UNIT_FPSX10) | UNIT_M(UNIT_JX10) | UNIT_M(UNIT_FTLBFX10) | UNIT_M(UNIT_PFX10))	//units off the velocity
+#define TICKS_US				(F_CPU / 1000000ul)	//ticks per us at the 1x prescaler
+
+typedef struct {
+	uint32_t usx10;							//interval, us x 10
+	uint32_t mpsx10, fpsx10;				//velocity. mpsx10 is worked out for any of the velocity units
+	uint32_t jx10, ftlbfx10, pfx10;			//energy / power factor
+} chrono_units_t;
+
+void chrono_units(chrono_units_t *u, uint32_t ticks, uint8_t ps, uint16_t mask) {
+	uint32_t vq;
+
+	ticks = ticks2x1(ticks, ps);
+	if (mask & UNIT_M(UNIT_USX10)) u->usx10 = ticks / TICKS_US * 10 + (ticks % TICKS_US * 10 + TICKS_US / 2) / TICKS_US;
+	if (!(mask & UNIT_M_V)) return;
+	vq = ticks2vq(ticks);					//the one divide
+	u->mpsx10 = VQ_ROUND(vq, cfg_vsh);
+	if (mask & UNIT_M(UNIT_FPSX10)) u->fpsx10 = VQ_FPSX10(vq, cfg_vsh);
+	if (mask & UNIT_M(UNIT_JX10)) u->jx10 = vq2energy(vq, KE_JX10);
+	if (mask & UNIT_M(UNIT_FTLBFX10)) u->ftlbfx10 = vq2energy(vq, KE_FTLBFX10);
+	if (mask & UNIT_M(UNIT_PFX10)) u->pfx10 = vq2pfx10(vq);
+}
+
+//convert a shadow pulse width to projectile length, in mm x 10 (mmx10)
+//the pulse width and the gate to gate ticks are on the same prescaler -> it cancels out
+uint32_t ticks2lenx10(uint32_t ticks, uint16_t width) {
+	return ((uint32_t) cfg.distance * width + ticks / 2) / ticks;
+}
+
+//flag a shot whose gate 1 / gate 2 pulse widths differ by more than 1/CHRONO_PULSE_TOL of the larger one
+//the same projectile shadows both gates: a mismatch means one of the gates triggered on something else
+uint8_t chrono_flags(chrono_rec_t *rec) {
+	uint16_t wmax = (rec->w1 > rec->w2)?rec->w1:rec->w2;
+	uint16_t wdif = (rec->w1 > rec->w2)?(rec->w1 - rec->w2):(rec->w2 - rec->w1);
+
+	return (wdif > wmax / CHRONO_PULSE_TOL)?CHRONO_F_WIDTH:0;
+}
+
+//convert ticks between two shots to rounds per minute x 10 (rpmx10) using integer math
+uint32_t ticks2rpmx10(uint32_t ticks, uint8_t ps) {
+	ticks = ticks2x1(ticks, ps);
+#if F_CPU <= 7158278ul
+	return 600ul * F_CPU / ticks;			//600*F_CPU fits in 32 bits -> one divide
+#else
+	//quotient and remainder come out of the same division -> x10 without overflowing 60*F_CPU
+	return 60ul * F_CPU / ticks * 10 + 60ul * F_CPU % ticks * 10 / ticks;
+#endif
+}
+
+//ms -> tmr1 overflows at prescaler ps, rounded, 1..255
+static uint8_t chrono_ms2ovf(uint16_t ms, uint8_t ps) {
+	uint32_t n = ((uint32_t) ms * (F_CPU / 1000ul) + (1ul << (15 + tmr1ps_shift[ps]))) >> (16 + tmr1ps_shift[ps]);
+
+	return (n < 1)?1:((n > 255)?255:n);
+}
+
+//convert the filter window, holdoff and gate 2 lag to ticks of prescaler ps, the display times to its overflows
+//interrupts on: the variable shifts and multiplies take hundreds of cycles. the isrs see the result once copied to chrono_lim
+void chrono_limits(chrono_lim_t *lim, uint8_t ps) {
+	lim->min = (uint32_t) CHRONO_MIN_US * (F_CPU / 1000000ul) >> tmr1ps_shift[ps];
+	lim->max = (uint32_t) CHRONO_MAX_US * (F_CPU / 1000000ul) >> tmr1ps_shift[ps];
+	lim->hold = (uint32_t) CHRONO_HOLDOFF_US * (F_CPU / 1000000ul) >> tmr1ps_shift[ps];
+	lim->skew = ((uint16_t) cfg.skew + ((1u << tmr1ps_shift[ps]) >> 1)) >> tmr1ps_shift[ps];	//rounded
+	lim->gap = chrono_ms2ovf(CHRONO_BURST_GAP_MS, ps);
+#if defined(CHRONO_BURST)
+	lim->dwell = chrono_ms2ovf(CHRONO_BURST_SHOW_MS, ps);
+#else
+	lim->dwell = chrono_ms2ovf(CHRONO_STATS_SHOW_MS, ps);
+#endif
+}
+
+#if defined(CHRONO_AUTORANGE)
+uint32_t range_peak=0;						//recent interval peak, in 1x ticks. decays by 1/8 per shot
+uint8_t range_ps=CHRONO_PS;					//prescaler picked by the autorange
+
+//autorange: track the recent interval peak and pick the finest prescaler at which it stays under 0x8000 ticks
+//-> a shot spans at most one tmr1 wrap, and the gate 2 timeout (in tmr1 overflows) scales with the range
+void chrono_range(uint32_t ticks, uint8_t ps) {
+	uint8_t i;
+
+	ticks = ticks2x1(ticks, ps);			//to 1x ticks
+	range_peak -= range_peak / 8;			//forget old shots gradually
+	if (ticks > range_peak) range_peak = ticks;	//but follow a slower shot right away
+	for (i = TMR1PS_1x; i < TMR1PS_1024x; i++)
+		if (range_peak < (0x8000ul << tmr1ps_shift[i])) break;
+	range_ps = i;
+}
+#endif
+
+//crc-8, polynomial 0x07 (x^8+x^2+x+1), initial value 0
+uint8_t crc8(uint8_t crc, uint8_t dat) {
+	uint8_t i;
+
+	crc ^= dat;
+	for (i=0; i<8; i++) crc = (crc & 0x80)?((crc << 1) ^ 0x07):(crc << 1);
+	return crc;
+}
+
+//crc-8 of the configuration, crc field excluded
+uint8_t cfg_crc(chrono_cfg_t *c) {
+	uint8_t *p = (uint8_t *) c;
+	uint8_t i, crc=0;
+
+	for (i=0; i<sizeof(chrono_cfg_t) - 1; i++) crc = crc8(crc, p[i]);
+	return crc;
+}
+
+//work out the per-shot constants from the configuration -> the conversions only divide
+void cfg_apply(void) {
+	cfg_kmps = (uint32_t) cfg.distance * 1000ul * (F_CPU / 1000000ul);
+	VQ_SHIFT(cfg_vsh, cfg_kmps);			//largest shift that fits 32 bits
+	cfg_kq = cfg_kmps << cfg_vsh;
 }
 
-//convert ticks to meters per second x 10 (mpsx10) using integer math
-uint32_t ticks2mpsx10(uint32_t ticks) {
-	uint32_t tmp = (uint32_t) CHRONO_DISTANCE * 1000ul * (F_CPU / 1000000ul) / ticks;
-	switch (TCCR1B & 0x07) {
-		case TMR1PS_1x: tmp /= 1; break;
-		case TMR1PS_8x: tmp /= 8; break;
-		case TMR1PS_64x: tmp /= 64; break;
-		case TMR1PS_256x: tmp /= 256; break;
-		case TMR1PS_1024x: tmp /= 1024; break;
-	};
-	return tmp;
+//load the configuration from eeprom. wrong version or crc -> the compile-time defaults
+void cfg_load(void) {
+	eeprom_read_block(&cfg, &cfg_ee, sizeof(cfg));
+	if ((cfg.ver != CFG_VER) || (cfg.crc != cfg_crc(&cfg))) {
+		cfg.ver = CFG_VER;
+		cfg.distance = CHRONO_DISTANCE;
+		cfg.ps = CHRONO_PS;
+		cfg.trigger = CHRONO_TRIGGER;
+		cfg.unit = CHRONO_UNIT;
+		cfg.mass = CHRONO_MASS;
+		cfg.skew = CHRONO_SKEW2;
+#if defined(OSCCAL_CAL)
+		cfg.osccal = OSCCAL_CAL;
+#else
+		cfg.osccal = OSCCAL;				//factory value
+#endif
+	}
+	cfg_apply();
 }
 
-//convert ticks to ft per second x 10 (fpsx10) using integer math
-uint32_t ticks2fpsx10(uint32_t ticks) {
-	return ticks2mpsx10(ticks) * 32804ul/10000;			//1meter = 3.28084
+//save the configuration to eeprom. unchanged bytes are not rewritten
+void cfg_save(void) {
+	cfg.ver = CFG_VER;
+	cfg.crc = cfg_crc(&cfg);
+	eeprom_update_block(&cfg, &cfg_ee, sizeof(cfg));
+}
+
+#if defined(CHRONO_BENCH) && !defined(CHRONO_CONSOLE)
+#error "CHRONO_BENCH needs CHRONO_CONSOLE: the results go out on the usart"
+#endif
+#if defined(CHRONO_CONSOLE)
+//console i/o, polled: nothing else runs while the console is up
+void cfg_putc(char ch) {
+	while (!(UCSRA & (1<<UDRE))) continue;	//wait for the tx buffer
+	UCSRA = (1<<U2X) | (1<<TXC);			//1->clear TXC: set again once this byte is out
+	UDR = ch;
+}
+
+void cfg_puts(const char *str) {
+	while (*str) cfg_putc(*str++);
+}
+
+void cfg_putu(uint32_t val) {
+	uint8_t dig[BCD32_DIGITS];
+	uint8_t n=0;
+
+	bcd32(val, dig);
+	while ((n < BCD32_DIGITS - 1) && (dig[n] == 0)) n++;	//no leading zeros
+	while (n < BCD32_DIGITS) cfg_putc('0' + dig[n++]);
 }
 
+#if defined(CHRONO_BENCH)
+//conversion / bcd benchmark, console command b
+//each strategy runs over bench_ticks[] with tmr1 at the 1x prescaler and interrupts off -> tmr1 ticks are cpu cycles
+//reported as "<name> <min> <max>", cycles per call less the timing overhead, then the flash / static ram of this build
+//the memory cost of an option (CHRONO_LUT, the soft float here) is the difference between builds with / without it
+const uint32_t bench_ticks[]={100, 494, 1000, 4936, 10000, 49360, 100000ul, 1000000ul};	//1x ticks. 494 = 1000m/s over 123.4mm@4Mhz
+#define BENCH_N					(sizeof(bench_ticks) / sizeof(bench_ticks[0]))
+volatile uint32_t bench_sink;				//results land here -> not optimized out
+uint8_t bench_dig[BCD32_DIGITS];			//digits land here -> not optimized out
+extern char __data_load_end, __bss_end;		//from the linker: end of the flash image / of the static ram
+
+static uint32_t bench_nop(uint32_t t) {return t;}	//the timing overhead
+static uint32_t bench_fp(uint32_t t) {return ticks2mpsx10_fp(t, TMR1PS_1x);}
+static uint32_t bench_div(uint32_t t) {return cfg_kmps / t;}	//one divide, truncated: the integer path before chrono_units()
+static uint32_t bench_mps(uint32_t t) {return ticks2mpsx10(t, TMR1PS_1x);}
+static uint32_t bench_all(uint32_t t) {
+	chrono_units_t u;
+
+	chrono_units(&u, t, TMR1PS_1x, 0xffff);	//every unit off the velocity
+	return u.fpsx10 + u.ftlbfx10;
+}
+#if defined(CHRONO_LUT)
+static uint32_t bench_lut(uint32_t t) {return ((t >= LUT_TMIN) && (t < LUT_TMAX))?lut_ticks2mpsx10(t):0;}
+#endif
+static uint32_t bench_bcd16(uint32_t t) {bcd16((uint16_t) t, bench_dig); return 0;}
+static uint32_t bench_div10(uint32_t t) {	//the divide / modulo loop bcd16() replaced
+	uint16_t v = t;
+	uint8_t i;
+
+	for (i = BCD16_DIGITS; i--; ) {bench_dig[i] = v % 10; v /= 10;}
+	return 0;
+}
+static uint32_t bench_bcd32(uint32_t t) {bcd32(t, bench_dig); return 0;}
+
+typedef struct {
+	const char *name;
+	uint32_t (*fn)(uint32_t t);
+} bench_t;
+
+const bench_t bench_fns[]={
+	{"", bench_nop},						//first: the overhead
+	{"fp", bench_fp},
+	{"div", bench_div},
+	{"mps", bench_mps},
+	{"all", bench_all},
+#if defined(CHRONO_LUT)
+	{"lut", bench_lut},
+#endif
+	{"bcd16", bench_bcd16},
+	{"div10", bench_div10},
+	{"bcd32", bench_bcd32},
+};
+
+void chrono_bench(void) {
+	uint8_t tccr1b = TCCR1B;
+	uint8_t i, j;
+	uint16_t c, lo, hi, ovh = 0;
+
+	TCCR1B = (tccr1b & ~0x07) | TMR1PS_1x;
+	for (j = 0; j < sizeof(bench_fns) / sizeof(bench_fns[0]); j++) {
+		lo = 0xffff; hi = 0;
+		for (i = 0; i < BENCH_N; i++) {
+			TCNT1 = 0;
+			bench_sink = bench_fns[j].fn(bench_ticks[i]);
+			c = TCNT1 - ovh;
+			if (c < lo) lo = c;
+			if (c > hi) hi = c;
+		}
+		if (j == 0) {ovh = lo; continue;}
+		cfg_puts(bench_fns[j].name);
+		cfg_putc(' '); cfg_putu(lo);
+		cfg_putc(' '); cfg_putu(hi);
+		cfg_puts("\r\n");
+	}
+	cfg_puts("flash "); cfg_putu((uint16_t) &__data_load_end);
+	cfg_puts(" sram "); cfg_putu((uint16_t) &__bss_end - RAMSTART);
+	cfg_puts("\r\n");
+	TCCR1B = tccr1b;
+}
+#endif
+
+//report the configuration: d<distance> p<prescaler> t<trigger> u<unit> o<osccal> m<mass> k<skew>
+void cfg_report(void) {
+	cfg_putc('d'); cfg_putu(cfg.distance);
+	cfg_puts(" p"); cfg_putu(cfg.ps);
+	cfg_puts(" t"); cfg_putu(cfg.trigger);
+	cfg_puts(" u"); cfg_putu(cfg.unit);
+	cfg_puts(" o"); cfg_putu(cfg.osccal);
+	cfg_puts(" m"); cfg_putu(cfg.mass);
+	cfg_puts(" k"); cfg_putu(cfg.skew);
+	cfg_puts("\r\n");
+}
+
+//execute a command line: a letter, then a decimal number where needed
+//	d1234	sensor distance, x10mm		p1..5	tmr1 prescaler, TMR1PS_x	t0/1	leading edge, RISING/FALLING
+//	u0..8	display unit, UNIT_x		o0..255	OSCCAL, from the next power-up
+//	m1470	projectile mass, grains x10	g9525	projectile mass, mg
+//	k0..255	gate 2 lag, cpu clocks
+//	?		report						w		save to eeprom				q		leave the console
+//	b		benchmark, CHRONO_BENCH
+//return 1 for q
+char cfg_cmd(char *str) {
+	char cmd = *str++;
+	char ok = 1;
+	uint32_t val = 0;
+
+	while (*str == ' ') str++;
+	if ((*str < '0') || (*str > '9')) ok = (cmd == '?') || (cmd == 'w') || (cmd == 'q') || (cmd == 'b');	//only those go without a number
+	while ((*str >= '0') && (*str <= '9') && (val < 100000ul)) val = val * 10 + (*str++ - '0');
+	if (ok) switch (cmd) {
+		case 'd': if ((val > 0) && (val <= 0xffff)) cfg.distance = val; else ok = 0; break;
+		case 'p': if ((val >= TMR1PS_1x) && (val <= TMR1PS_1024x)) cfg.ps = val; else ok = 0; break;
+		case 't': if (val <= FALLING) cfg.trigger = val; else ok = 0; break;
+		case 'u': if (val <= UNIT_PFX10) cfg.unit = val; else ok = 0; break;
+		case 'm': if ((val > 0) && (val <= 0xffff)) cfg.mass = val; else ok = 0; break;
+		case 'g': val = ((uint64_t) val * 10114 + 0x8000) >> 16;	//mg -> grains x10
+			if ((val > 0) && (val <= 0xffff)) cfg.mass = val; else ok = 0; break;
+		case 'o': if (val <= 0xff) cfg.osccal = val; else ok = 0; break;
+		case 'k': if (val <= 0xff) cfg.skew = val; else ok = 0; break;
+		case 'w': cfg_save(); break;
+		case '?': break;
+#if defined(CHRONO_BENCH)
+		case 'b': chrono_bench(); break;
+#endif
+		case 'q': return 1;
+		default: ok = 0; break;
+	}
+	if (ok) {cfg_apply(); cfg_report();} else cfg_puts("?\r\n");
+	return 0;
+}
+
+//power-up console on the usart: any key within CFG_WAIT ms enters it, q leaves it
+//must run before led_init(): the display takes RXD/TXD back once the usart is off
+void cfg_console(void) {
+	char line[16];							//command line
+	uint8_t n=0;
+	uint16_t t;
+	char ch;
+
+	UBRRH = (F_CPU / 8 / CFG_BAUD - 1) >> 8;
+	UBRRL = (F_CPU / 8 / CFG_BAUD - 1);
+	UCSRA = (1<<U2X);						//double speed: finer baud steps
+	UCSRC = (1<<URSEL) | (1<<UCSZ1) | (1<<UCSZ0);	//URSEL=1->write UCSRC. 0b11->8 data bits, no parity, 1 stop bit
+	UCSRB = (1<<RXEN) | (1<<TXEN);
+	cfg_puts("chrono: key for setup\r\n");
+	for (t=0; (t < CFG_WAIT) && !(UCSRA & (1<<RXC)); t++) delay_ms(1);
+	if (UCSRA & (1<<RXC)) {
+		ch = UDR;							//the key itself is not a command
+		cfg_report();
+		do {
+			while (!(UCSRA & (1<<RXC))) continue;
+			ch = UDR;
+			if ((ch == '\r') || (ch == '\n')) {
+				line[n] = 0; n = 0;
+				if (line[0] && cfg_cmd(line)) break;
+			} else if (n < sizeof(line) - 1) line[n++] = ch;
+		} while (1);
+	}
+	while (!(UCSRA & (1<<TXC))) continue;	//let the last byte out
+	UCSRB = 0;								//usart off -> PD0/PD1 back to the display
+}
+#endif
+
 //reset the chrono
 //tmr1 free running, no overflow interrupt
 //ICP1 at 1x sampling.
 void chrono_init(void) {
+	chrono_lim_t lim;
+
 	//reset chrono variables
-	ticks = chrono_ticks = 0;
-	chrono_available = 0;					//no new data
+	ticks = 0;
+	chrono_head = chrono_tail = 0;			//empty the capture ring
+	chrono_ovf = 0;
+	chrono_state = CHRONO_IDLE;				//ready to fire
+	chrono_timer = chrono_misses = 0;
+	chrono_prev_ok = 0;
+	chrono_rejects = 0;
+#if defined(CHRONO_LEAN)
+	cap_head = cap_tail = 0;				//empty the raw edge ring
+	cap_lost = 0;
+#endif
+	chrono_limits(&lim, cfg.ps);			//filter window for the starting prescaler
+	chrono_lim = lim;						//the isrs are not on yet
+#if defined(CHRONO_AUTORANGE)
+	range_ps = cfg.ps;
+#endif
+#if defined(CHRONO_LEAN)
+	chrono_ices[0] = chrono_ices[3] = (CHRONO_LEAD == RISING)?0x40:0x00;	//ICES1: leading edge on gate 1, trailing edge on gate 2 (inverted)
+	chrono_ices[1] = chrono_ices[2] = chrono_ices[0] ^ 0x40;
+#endif
+#if defined(CHRONO_BURST)
+	burst_n = burst_idle = 0;				//empty the burst buffer
+	burst_done = 0;
+#endif
 
 	//set up the indicators
 	//led_start / _stop as output, on
@@ -126,6 +911,13 @@ void chrono_init(void) {
 	//chrono input pin as input, with pull-up enabled
 	IO_IN(CHRONO_DDR, CHRONO); 				//pin as input
 	IO_SET(CHRONO_PORT, CHRONO);			//enable pull-up
+	IO_IN(CHRONO2_DDR, CHRONO2);			//gate 2 pin as input
+	IO_SET(CHRONO2_PORT, CHRONO2);			//enable pull-up
+
+	//analog comparator on, bandgap (1.23v) on the positive input, AIN1 on the negative input
+	//comparator interrupt off, not yet routed to input capture
+	SFIOR &=~(1<<ACME);						//0->AIN1 is the negative input
+	ACSR = (0<<ACD) | (1<<ACBG) | (0<<ACIE) | (0<<ACIC);
 
 	//configure tmr1 as free-running, 1x prescaler
 	//TCCR1A = TCCR1B = 0;
@@ -135,12 +927,18 @@ void chrono_init(void) {
 	TCCR1B = (TCCR1B & ~0x18) | (0x00 & 0x18);
 
 	//configure input capture on ICP1/PB0
+#if defined(CHRONO_ICNC)
+	//enable noise filter -> 4 equal samples needed. applies after the ACIC mux, so its 4-clock delay is the same on both gates
+	TCCR1B = (TCCR1B & ~0x80) | (0x80 & 0x80);
+#else
 	//disable noise filter -> capture on the first edge
 	TCCR1B = (TCCR1B & ~0x80) | (0x00 & 0x80);
-#if CHRONO_TRIGGER == RISING
-	TCCR1B = (TCCR1B & ~0x40) | (0x40 & 0x40);	//1->rising edge
+#endif
+	//either way the comparator in front of gate 2 adds its own delay (CHRONO_SKEW2): chrono_proc() takes chrono_skew off gate 2
+#if defined(CHRONO_LEAN)
+	chrono_hw(CHRONO_STEP(CHRONO_GATE1, CHRONO_LEAD));	//armed on gate 1, leading edge per CHRONO_TRIGGER
 #else
-	TCCR1B = (TCCR1B & ~0x40) | (0x00 & 0x40);	//0->falling edge
+	chrono_sel(CHRONO_GATE1, CHRONO_LEAD);	//armed on gate 1, leading edge per CHRONO_TRIGGER
 #endif
 
 	//enable tmr1 input capture interrupt
@@ -148,18 +946,119 @@ void chrono_init(void) {
 	TIMSK |= (1<<TICIE1) | (1<<TOIE1);					//1->enable the input capture interrupt
 
 	//start tmr1
-	TCCR1B = (TCCR1B & ~0x07) | (CHRONO_PS & 0x07);	//start timer on 1x prescaler
+	TCCR1B = (TCCR1B & ~0x07) | (cfg.ps & 0x07);	//start timer on the configured prescaler
+}
+
+//the value of a record in the display unit, cfg.unit. only that unit is worked out
+uint32_t chrono_value(chrono_rec_t *rec) {
+	chrono_units_t val;
+
+	chrono_units(&val, rec->ticks, rec->ps, UNIT_M(cfg.unit));
+	switch (cfg.unit) {
+		default:
+		case UNIT_TICKS: return rec->ticks % 10000;
+		case UNIT_USX10: return val.usx10;							//1000 ticks@8Mhz -> 125us
+		case UNIT_MPSX10: return val.mpsx10;						//123.4mm/125us=987.2. rounded
+		case UNIT_FPSX10: return val.fpsx10;						//987.2mps->3238.8. rounded off vq, not off mpsx10
+		case UNIT_RPMX10: return rec->period?ticks2rpmx10(rec->period, rec->ps):0;	//cyclic rate: 1200rpm@4Mhz = 200000 ticks -> 12000, displayed as 1200.
+		case UNIT_LENX10: return ticks2lenx10(rec->ticks, ((uint32_t) rec->w1 + rec->w2) / 2);	//projectile length, mmx10. needs CHRONO_PULSE
+		case UNIT_JX10: return val.jx10;							//147.0gr@987.2mps -> 4641.5J, displayed as 4642
+		case UNIT_FTLBFX10: return val.ftlbfx10;					//-> 3423.4ft.lbf, displayed as 3423
+		case UNIT_PFX10: return val.pfx10;							//-> pf 476.1
+	}
+}
+
+//display a x10 value (velocities are x10) by forming the string in display buffer lRAM[]
+//the decimal point of the first digit is the status indicator and is left alone
+void led_show(uint32_t tmp) {
+	char dp;								//dp = decimal point, =2(digit 3) or 3(digit 4)
+	uint8_t dig[BCD16_DIGITS];				//digits of tmp, most significant first
+
+	if (tmp > 99999 - 5) {tmp = 99999 - 5;}				//bound tmp, dp on digit 4. "5" here for rounding
+#if defined(CHRONO_DP)
+	//decide where the decimal point should be, digit 3 or digit 4
+	//allows for rounding
+	if (tmp > 9999) {tmp = (tmp + 5) / 10; dp = 3;} else {tmp /= 1; dp = 2;}	//only two decimal points are displayed
+#else
+	tmp = (tmp + 5) / 10;								//4 digits only, rounding applied. "/10" due to speed measurements being x10.
+#endif
+	//tmp is 0..9999 here -> digits 1..4 of bcd16(). constant time: no flicker at 1Mhz
+	bcd16(tmp, dig);
+	lRAM[0]=ledfont_num[dig[1]] | (lRAM[0] & 0x80);
+	lRAM[1]=ledfont_num[dig[2]];
+	lRAM[2]=ledfont_num[dig[3]];
+	lRAM[3]=ledfont_num[dig[4]];
+#if defined(CHRONO_DP)
+	//display the decimal point
+	switch (dp) {
+		case 2: lRAM[2]|=0x80; break;					//dp on digit 3
+		case 3: lRAM[3]|=0x80; break;					//decimal point on digit 4
+	}
+#endif
+}
+
+#if defined(CHRONO_STATS)
+//statistics replay: shots, then label / value of each of stats_label[] in turn
+const char *stats_label[]={"avg", "sd", "es", "lo", "hi"};
+#define STATS_SHOW_N			(1 + 2 * sizeof(stats_label) / sizeof(stats_label[0]))	//replay steps
+
+//show step i of the replay. the decimal point of the first digit is the status indicator and is left alone
+void stats_show(uint8_t i) {
+	uint8_t dig[BCD16_DIGITS];
+	const char *lbl;
+	uint8_t j, st = lRAM[0] & 0x80;			//status indicator
+
+	if (i == 0) {							//shots: "n 10"
+		bcd16(stats.n, dig);
+		lRAM[0]=ledfont_alpha['n' - 'a'] | st;
+		lRAM[1]=(dig[2])?ledfont_num[dig[2]]:0x00;
+		lRAM[2]=(dig[2] || dig[3])?ledfont_num[dig[3]]:0x00;
+		lRAM[3]=ledfont_num[dig[4]];
+		return;
+	}
+	i -= 1;
+	if (!(i & 0x01)) {						//label
+		lbl = stats_label[i / 2];
+		for (j = 0; j < 4; j++) lRAM[j] = (*lbl)?ledfont_alpha[*lbl++ - 'a']:0x00;
+		lRAM[0] |= st;
+		return;
+	}
+	switch (i / 2) {						//value, x10 like the shots
+		default:
+		case 0: led_show(stats_mean(&stats)); break;
+		case 1: led_show(stats_sd(&stats)); break;
+		case 2: led_show(stats_es(&stats)); break;
+		case 3: led_show(stats.min); break;
+		case 4: led_show(stats.max); break;
+	}
 }
+#endif
 
 int main(void) {
 	uint32_t tmp;							//number to be displayed
-	char tmp1, dp;							//dp = decimal point, =2(digit 3) or 3(digit 4)
+	uint8_t flags=0;						//flags of the latest record, CHRONO_F_x
+	chrono_rec_t rec;						//capture record
+	char rec_new;							//1=new records drained this pass
 	uint16_t cnt=0;							//counter
+#if defined(CHRONO_BURST)
+	uint8_t i;								//index
+	uint8_t ps;								//prescaler of the string
+	uint8_t show_n=0, show_i=0;				//replay: entries (2 per shot: velocity, rate), current entry
+	uint8_t show_t=0;						//replay: ovf8 when the current entry went up
+#endif
+#if defined(CHRONO_STATS)
+	uint8_t show_i=0, show_t=0;				//statistics replay: current step, ovf8 when it went up
+#endif
+#if defined(CHRONO_AUTORANGE)
+	chrono_lim_t lim;						//limits of the next prescaler
+#endif
 
 	mcu_init();								//reset the mcu
 
-#if defined(OSCCAL_CAL)
-	OSCCAL = OSCCAL_CAL;					//calibration for Internal RC oscillator
+	cfg_load();								//configuration from eeprom, or the defaults
+	OSCCAL = cfg.osccal;					//calibration for Internal RC oscillator
+#if defined(CHRONO_CONSOLE)
+	cfg_console();							//setup, before the display takes PD0/PD1
 #endif
 	led_init();								//reset the led
 	chrono_init();							//reset the chrono
@@ -184,49 +1083,94 @@ int main(void) {
 #endif
 
 
-		//convert chrono_ticks only if the data is new
-		//chrono_available=1;
-		if (chrono_available) {
-			chrono_available = 0;
-			//chrono_ticks = 8307674ul;								//for debugging only - to make sure that the math is correct
-			//tmp = cnt++;
-			//pick the variable to display
-			tmp = chrono_ticks % 10000;
-			//tmp = ticks2usx10(chrono_ticks);					//1000 ticks@8Mhz -> 125us
-			//tmp = ticks2mpsx10_fp(chrono_ticks);				//123.4mm/125us=987.2, displayed as 987.2. very minor flickering at 1Mhz
-			//tmp = ticks2mpsx10(chrono_ticks);					//123.4mm/125us=987.2, displayed as 987. no flickering at 1Mhz. with rouding.
-			//tmp = ticks2fpsx10(chrono_ticks);					//987.2mps->3238.845, displayed as 3238. no flickering at 1Mhz. with rouding.
-			if (tmp > 99999 - 5) {tmp = 99999 - 5;}				//bound tmp, dp on digit 4. "5" here for rounding
-#if defined(CHRONO_DP)
-			//decide where the decimal point should be, digit 3 or digit 4
-			//allows for rounding
-			if (tmp > 9999) {tmp = (tmp + 5) / 10; dp = 3;} else {tmp /= 1; dp = 2;}	//only two decimal points are displayed
-#else
-			tmp = (tmp + 5) / 10;								//4 digits only, rounding applied. "/10" due to speed measurements being x10.
-#endif
-			//display tmp by forming the string in display buffer lRAM[]
-#ifdef FAST_MATH
-			//faster display routine - no flicker at 1Mhz
-			tmp1=0; while (tmp >= 1000) {tmp -=1000; tmp1+=1;}; lRAM[0]=ledfont_num[tmp1] | (lRAM[0] & 0x80);
-			tmp1=0; while (tmp >=  100) {tmp -= 100; tmp1+=1;}; lRAM[1]=ledfont_num[tmp1];
-			tmp1=0; while (tmp >=   10) {tmp -=  10; tmp1+=1;}; lRAM[2]=ledfont_num[tmp1];
-			/*tmp1=0; while (tmp >= 0001) {tmp -=0001; tmp1+=1;}; */lRAM[3]=ledfont_num[tmp];
-#else
-			//slower display routine - slight flicker at 1Mhz
-			lRAM[3]=ledfont_num[(tmp % 10) + 0]; tmp /= 10;
-			lRAM[2]=ledfont_num[(tmp % 10) + 0]; tmp /= 10;
-			lRAM[1]=ledfont_num[(tmp % 10) + 0]; tmp /= 10;
-			lRAM[0]=ledfont_num[(tmp % 10) + 0] | (lRAM[0] & 0x80); tmp /= 10;
+#if defined(CHRONO_BURST)
+		//while a string is in progress the main loop only refreshes the display
+		if (burst_done) {
+			//string ended: convert every shot, then hand burst[] back to the capture isr
+			//the prescaler only changes between strings -> the whole string was taken on the current one
+			ps = TCCR1B & 0x07;
+			for (i=0; i<burst_n; i++) {
+				tmp = ticks2mpsx10(burst[i].end - burst[i].start, ps);
+				burst_v[i] = (tmp > 0xffff)?0xffff:tmp;
+				tmp = i?ticks2rpmx10(burst[i].start - burst[i - 1].start, ps):0;
+				burst_r[i] = (tmp > 0xffff)?0xffff:tmp;
+#if defined(CHRONO_AUTORANGE)
+				chrono_range(burst[i].end - burst[i].start, ps);
 #endif
-#if defined(CHRONO_DP)
-			//display the decimal point
-			switch (dp) {
-				case 2: lRAM[2]|=0x80; break;					//dp on digit 3
-				case 3: lRAM[3]|=0x80; break;					//decimal point on digit 4
 			}
+			show_n = burst_n * 2; show_i = 0; show_t = ovf8 - chrono_lim.dwell;	//start the replay right away
+			burst_n = burst_idle = 0;			//release the buffer: burst_n first, burst_done last
+			burst_done = 0;
+		}
+		//replay the last string: velocity, then cyclic rate, of each shot in turn
+		if (show_n && ((uint8_t) (ovf8 - show_t) >= chrono_lim.dwell)) {
+			show_t = ovf8;
+			led_show((show_i & 0x01)?burst_r[show_i / 2]:burst_v[show_i / 2]);
+			if (++show_i >= show_n) show_i = 0;	//and around again
+		}
+#endif
+
+#if defined(CHRONO_LEAN)
+		chrono_edges();						//raw edges -> capture records
+#endif
+		//drain the capture ring in one batch. only the latest record is converted for display
+		rec_new = 0;
+		while (chrono_pop(&rec)) {
+			rec_new = 1;
+			//per-record processing goes here
+#if defined(CHRONO_AUTORANGE)
+			chrono_range(rec.ticks, rec.ps);
 #endif
+#if defined(CHRONO_PULSE)
+			flags = chrono_flags(&rec);			//pulse widths agree?
+#endif
+#if defined(CHRONO_STATS)
+			//every shot goes into the string, not just the one on display. main loop only: the capture isr is untouched
+			if (stats.n >= CHRONO_STRING) stats_reset(&stats);	//the last string is complete: a new one
+			tmp = chrono_value(&rec);
+			stats_add(&stats, tmp);
+#endif
+		}
+		if (rec_new) {
+			//rec.ticks = 8307674ul;								//for debugging only - to make sure that the math is correct
+			//tmp = cnt++;
+#if !defined(CHRONO_STATS)
+			tmp = chrono_value(&rec);							//pick the variable to display, per cfg.unit
+#endif
+			led_show(tmp);										//format tmp into lRAM[]
+			if (flags & CHRONO_F_WIDTH) lRAM[1] |= 0x80;		//dp on digit 2: suspect trigger
 			//LED_ON(LED_START | LED_STOP);						//turn on both leds to indicate ready to fire status
+#if defined(CHRONO_STATS)
+			show_i = 0; show_t = ovf8;							//last shot of a string: the replay follows, after it has been shown
+#endif
+		}
+#if defined(CHRONO_STATS)
+		//string complete: replay its statistics until the next shot
+		if ((stats.n >= CHRONO_STRING) && ((uint8_t) (ovf8 - show_t) >= chrono_lim.dwell)) {
+			show_t = ovf8;
+			stats_show(show_i);
+			if (++show_i >= STATS_SHOW_N) show_i = 0;	//and around again
 		}
+#endif
+
+#if defined(CHRONO_AUTORANGE)
+		//switch the prescaler only while no measurement is under way (and no string is being recorded)
+		//the extended time base is not continuous across the switch -> the next period is unknown
+#if defined(CHRONO_BURST)
+		if ((range_ps != (TCCR1B & 0x07)) && !chrono_busy() && (burst_n == 0)) {
+#else
+		if ((range_ps != (TCCR1B & 0x07)) && !chrono_busy()) {
+#endif
+			chrono_limits(&lim, range_ps);	//filter window for the new prescaler, interrupts on
+			di();
+			if (!chrono_busy()) {			//check again, with the capture isr held off
+				TCCR1B = (TCCR1B & ~0x07) | (range_ps & 0x07);
+				chrono_lim = lim;			//15 bytes: the prescaler and its limits change together
+				chrono_prev_ok = 0;
+			}
+			ei();
+		}
+#endif
 
 		//blanking here if needed
 		led_display();						//display lRAM[]
@@ -0,0 +1,50 @@
+#include "stats.h"							//we use shot-string statistics
+
+//square root of v, rounded. bit by bit: shifts and adds only
+static uint32_t isqrt64(uint64_t v) {
+	uint64_t r = 0, b = 1ull << 62;
+
+	while (b > v) b >>= 2;
+	while (b) {
+		if (v >= r + b) {v -= r + b; r = (r >> 1) + b;} else r >>= 1;
+		b >>= 2;
+	}
+	return (v > r)?(r + 1):r;				//v is now the remainder: round up past r + 1/2
+}
+
+//start a new string
+void stats_reset(stats_t *s) {
+	s->n = 0;
+	s->mean = 0;
+	s->m2 = 0;
+	s->min = s->max = 0;
+}
+
+//add a shot to the string: Welford's update
+//	mean += (x - mean) / n; m2 += (x - mean before) * (x - mean after)
+//no running sums of x / x^2 -> no cancellation, and the mean stays within 32 bits
+void stats_add(stats_t *s, uint32_t x) {
+	int32_t d, d2;
+
+	if (s->n >= STATS_NMAX) return;
+	if (x > STATS_XMAX) x = STATS_XMAX;
+	if (!s->n || (x < s->min)) s->min = x;
+	if (!s->n || (x > s->max)) s->max = x;
+	s->n += 1;
+	d = ((int32_t) x << STATS_Q) - s->mean;	//from the old mean
+	s->mean += (d < 0)?-((-d + s->n / 2) / s->n):((d + s->n / 2) / s->n);	//rounded
+	d2 = ((int32_t) x << STATS_Q) - s->mean;	//from the new mean
+	if ((d < 0) == (d2 < 0)) s->m2 += (int64_t) d * d2;	//same sign, but for the rounding of the mean near 0
+}
+
+//mean of the string, rounded
+uint32_t stats_mean(const stats_t *s) {
+	return ((uint32_t) s->mean + (1ul << (STATS_Q - 1))) >> STATS_Q;
+}
+
+//sample standard deviation of the string, rounded
+//m2 / (n - 1) is the variance in Q(2 * STATS_Q) -> its root is in Q(STATS_Q)
+uint32_t stats_sd(const stats_t *s) {
+	if (s->n < 2) return 0;
+	return (isqrt64(s->m2 / (s->n - 1)) + (1ul << (STATS_Q - 1))) >> STATS_Q;
+}
@@ -0,0 +1,40 @@
+/*
+ * File:   stats.h
+ *
+ * shot-string statistics: running mean / standard deviation (Welford) in integer fixed point, min / max / extreme spread
+ */
+
+#ifndef STATS_H
+#define	STATS_H
+
+#include "gpio.h"							//uint8_t ... types
+
+//global defines
+#define STATS_Q				8				//fraction bits of the running mean
+#define STATS_NMAX			255				//shots per string. later shots are not counted
+#define STATS_XMAX			0xffffful		//largest value. larger values are counted as STATS_XMAX
+
+//constant memory, whatever the length of the string
+typedef struct {
+	uint8_t n;								//shots in the string
+	int32_t mean;							//running mean, Q(STATS_Q)
+	uint64_t m2;							//sum of the squared deviations from the mean, Q(2 * STATS_Q)
+	uint32_t min, max;						//extremes
+} stats_t;
+
+//extreme spread
+#define stats_es(s)			((s)->n?((s)->max - (s)->min):0)
+
+//start a new string
+void stats_reset(stats_t *s);
+
+//add a shot to the string. one divide
+void stats_add(stats_t *s, uint32_t x);
+
+//mean of the string, rounded
+uint32_t stats_mean(const stats_t *s);
+
+//sample standard deviation of the string, rounded. 0 for fewer than 2 shots
+uint32_t stats_sd(const stats_t *s);
+
+#endif	/* STATS_H */
@@ -0,0 +1,18 @@
+/*
+ * File:   tstamp.h
+ *
+ * extended time stamps: a 16-bit timer capture and a software count of the timer overflows
+ */
+
+#ifndef TSTAMP_H
+#define	TSTAMP_H
+
+//extend the 16-bit capture cap with msw, the overflow count in the bits above bit 15 (its lower 16 bits are 0)
+//msw is read after the capture, in an isr that outranks the overflow isr: if the timer wrapped around the time of
+//the capture, the overflow flag tov is still pending and msw has not been advanced yet. A pending overflow with the
+//capture in the lower half means the capture took place after the wrap -> count that overflow here. In the upper
+//half, the capture took place before the wrap -> msw is already correct.
+//assumes the isr runs within 0x8000 counts of the capture. msw: any unsigned type wide enough for the time stamp
+#define TS_EXTEND(msw, cap, tov)	((((tov) && ((cap) < 0x8000))?((msw) + 0x10000ul):(msw)) | (cap))
+
+#endif	/* TSTAMP_H */
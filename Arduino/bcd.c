@@ -0,0 +1,46 @@
+#include "bcd.h"							//we use bcd conversion
+
+//add 3 to each nibble of packed bcd byte b that is 5 or more, without branching:
+//nibble + 3 sets bit 3 exactly when the nibble is 5..9 -> that bit, shifted down to bits 1 and 0, is the 3 to add
+#define BCD_ADJ(b)			((b) + ((((b) + 0x33) & 0x88) >> 2) + ((((b) + 0x33) & 0x88) >> 3))
+
+//unpack n digits from packed bcd[] (bcd[0] = least significant two digits) into dig[], most significant first
+static void bcd_unpack(const uint8_t *bcd, uint8_t n, uint8_t *dig) {
+	uint8_t i, p;
+
+	for (i = 0; i < n; i++) {
+		p = n - 1 - i;						//nibble of digit i
+		dig[i] = (p & 0x01)?(bcd[p / 2] >> 4):(bcd[p / 2] & 0x0f);
+	}
+}
+
+//convert val to 5 decimal digits, dig[0..4], most significant first
+void bcd16(uint16_t val, uint8_t *dig) {
+	uint8_t bcd[3] = {0, 0, 0};				//packed bcd, least significant byte first
+	uint8_t i;
+
+	for (i = 0; i < 16; i++) {
+		bcd[0] = BCD_ADJ(bcd[0]); bcd[1] = BCD_ADJ(bcd[1]); bcd[2] = BCD_ADJ(bcd[2]);
+		//shift bcd:val left by one bit
+		bcd[2] = (bcd[2] << 1) | (bcd[1] >> 7);
+		bcd[1] = (bcd[1] << 1) | (bcd[0] >> 7);
+		bcd[0] = (bcd[0] << 1) | (val >> 15);
+		val <<= 1;
+	}
+	bcd_unpack(bcd, BCD16_DIGITS, dig);
+}
+
+//convert val to 10 decimal digits, dig[0..9], most significant first
+void bcd32(uint32_t val, uint8_t *dig) {
+	uint8_t bcd[5] = {0, 0, 0, 0, 0};		//packed bcd, least significant byte first
+	uint8_t i, j;
+
+	for (i = 0; i < 32; i++) {
+		for (j = 0; j < 5; j++) bcd[j] = BCD_ADJ(bcd[j]);
+		//shift bcd:val left by one bit
+		for (j = 4; j; j--) bcd[j] = (bcd[j] << 1) | (bcd[j - 1] >> 7);
+		bcd[0] = (bcd[0] << 1) | (val >> 31);
+		val <<= 1;
+	}
+	bcd_unpack(bcd, BCD32_DIGITS, dig);
+}
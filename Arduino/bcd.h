@@ -0,0 +1,32 @@
+/*
+ * File:   bcd.h
+ *
+ * binary to bcd conversion, shift-and-add-3 (double dabble)
+ */
+
+#ifndef BCD_H
+#define	BCD_H
+
+#include <stdint.h>							//uint8_t ... types
+
+//global defines
+#define BCD16_DIGITS		5				//digits out of bcd16()
+#define BCD32_DIGITS		10				//digits out of bcd32()
+
+#ifdef __cplusplus
+extern "C" {								//called from the sketch, compiled as c++
+#endif
+
+//convert val to 5 decimal digits, dig[0..4], most significant first
+//constant time: 16 passes over 3 bcd bytes, whatever the value
+void bcd16(uint16_t val, uint8_t *dig);
+
+//convert val to 10 decimal digits, dig[0..9], most significant first
+//constant time: 32 passes over 5 bcd bytes, whatever the value
+void bcd32(uint32_t val, uint8_t *dig);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* BCD_H */
@@ -7,28 +7,56 @@
 //#include "gpio.h"
 //#include "delay.h"							//we use software delays
 //#include "led4_pins.h"						//we use 4-digit led display - different wiring!
+#include <avr/eeprom.h>						//configuration in eeprom
+#include "bcd.h"							//binary to bcd conversion
+#include "tstamp.h"							//extended time stamps
+#include "stats.h"							//shot-string statistics
+#include "vq.h"								//velocity in fixed point
 
 //hardware configuration
 #define CHRONO_PORT				PORTB
 #define CHRONO_DDR				DDRB
-#define CHRONO					(1<<0)		//ICP1 on PB0
+#define CHRONO					(1<<0)		//ICP1 on PB0 (D8) -> gate 1 (start)
+#define CHRONO_GATE2_SRC		GATE2_ACIC	//gate 2 (stop) source: GATE2_ACIC or GATE2_INT0
+#define CHRONO2_PORT			PORTD
+#define CHRONO2_DDR				DDRD
+#define CHRONO2_AIN1			(1<<7)		//AIN1 on PD7 (D7) -> gate 2 for GATE2_ACIC, through the analog comparator into input capture
+#define CHRONO2_INT0			(1<<2)		//INT0 on PD2 (D2) -> gate 2 for GATE2_INT0, edge latched in INTF0, time stamped from TCNT1 in the isr
+#define CHRONO_INT0_LAT			40			//ticks from the INT0 edge to the TCNT1 read in the isr. calibrate with both gates on the same signal
+#define CHRONO_SKEW2			8			//gate 2 lag behind gate 1 with GATE2_ACIC, cpu clocks: the analog comparator delay (500ns@5v). taken off gate 2
 
 //status indicators - active high
 //status:
 //both indicators on: ready to receive data
 //LED_START on: both _start and _stop measurements have been taken. ready to take the next measurements.
 //LED_START off: first measurement has been taken, but second measurement not yet
-//if LED_START is stuck in "off", reset the chrono
+//if gate 2 never fires, the shot is counted as a miss and LED_START comes back on after CHRONO_TIMEOUT tmr1 overflows - no reset needed
 #define LED_PORT				PORTB
 #define LED_DDR					DDRB
 #define LED_START				(1<<1)		//start led on PB1
 #define LED_STOP				(0<<2)		//stop led on PB? - not used
 
-#define CHRONO_PS				TMR1PS_1x	//tmr1 prescaler
+//CHRONO_PS, CHRONO_DISTANCE, CHRONO_TRIGGER, CHRONO_UNIT, CHRONO_MASS, CHRONO_SKEW2 and OSCCAL_CAL are defaults: the eeprom copy (set from the console) wins
+#define CHRONO_PS				TMR1PS_1x	//tmr1 prescaler. 1x = 62.5ns resolution; the overflow count extends the range to 268s
 #define CHRONO_DISTANCE			1234		//chrono sensor distance, x10mm (1234=123.4mm)
 #define CHRONO_TRIGGER			RISING		//input capture on rising / falling edge
+#define CHRONO_UNIT				UNIT_TICKS	//value in the TLM_ASCII line: UNIT_TICKS / _USX10 / _MPSX10 / _FPSX10 / _JX10 / _FTLBFX10 / _PFX10
+#define CHRONO_MASS				1470		//projectile mass, grains x10 (1470=147.0gr) -> energy / power factor
 #define CHRONO_DP							//define CHRONO_DP if you want to show decimal point on digit 3/4.
-//#define FAST_MATH							//using faster math so the code runs at 1Mhz
+#define CHRONO_RING				8			//capture ring size, in records. power of 2, up to 128
+#define CHRONO_TIMEOUT			64			//tmr1 overflows to wait for gate 2 before the shot is a miss. 64 = 262ms@16Mhz, 1x prescaler
+#define CHRONO_LAT_US			20			//us from a capture to the ICR1 read past which the shot is flagged: a gate 2 edge this soon may have been missed
+											//worst on-time case at 16Mhz: one other isr (udre ~45 cycles, tmr1 overflow ~60) + entry to the ICR1 read (~40)
+											//= ~100 cycles, 6us. isrs don't nest -> they don't add up. no timer0 isr: main() here, the core's init() never runs
+//#define CHRONO_SHIELD						//define CHRONO_SHIELD to mask the telemetry (udre) interrupt while armed (gate 1 -> gate 2)
+											//-> only the tmr1 isrs between the gates. the frames queued meanwhile go out after gate 2 / the timeout
+
+#define TLM_BAUD				1000000ul	//telemetry baud rate, U2X. 1000000 / 500000 / 250000 are exact at 16Mhz; 9600 for a terminal
+//#define TLM_ASCII							//define TLM_ASCII for a text line per shot instead of the binary frame
+#define TLM_RING				64			//telemetry tx ring size, in bytes. power of 2, up to 128
+#define TLM_TEXT				40			//longest text line (console reply, string report), characters. up to TLM_RING - 3
+//#define CHRONO_STATS						//define CHRONO_STATS for shot-string statistics of the value in cfg.unit: a report line after the last shot of a string
+#define CHRONO_STRING			10			//shots per string, up to STATS_NMAX
 
 #define OSCCAL_CAL				0xbd		//0xbd@1mhz, 0xbf@2mhz, 0xbd@4Mhz, 0xcd@8Mhz. Device and frequency specific (b3 b2 ae ae)
 
@@ -46,6 +74,31 @@
 #define TMR1PS_64x				0x03		//0x03->64x prescaler
 #define TMR1PS_256x				0x04		//0x04->256x prescaler
 #define TMR1PS_1024x			0x05		//0x05->1024x prescaler
+#define GATE2_ACIC				0			//gate 2 on AIN1, analog comparator routed to input capture
+#define GATE2_INT0				1			//gate 2 on INT0
+#define CHRONO_GATE1			1			//start gate, on ICP1
+#define CHRONO_GATE2			2			//stop gate, on AIN1 or INT0
+#define CHRONO_IDLE				0			//waiting for gate 1 - ready to fire
+#define CHRONO_ARMED			1			//gate 1 seen, waiting for gate 2 - timeout running
+#define CHRONO_COMPLETE			2			//gate 2 seen, shot recorded
+#define CHRONO_F_OVERRUN		0x01		//record flag: a capture isr ran late / saw a second capture -> the shot may be corrupt
+#define CHRONO_F_INT0			0x02		//record flag: gate 2 time stamped from INT0 (GATE2_INT0), not input capture
+#define TLM_SYNC				0xc5		//first byte of a telemetry frame
+#define TLM_SYNC_TEXT			0xc6		//first byte of a text frame: a console reply / string report in binary mode
+#define UNIT_TICKS				0			//ascii unit: raw ticks
+#define UNIT_USX10				1			//ascii unit: us x 10
+#define UNIT_MPSX10				2			//ascii unit: m/s x 10
+#define UNIT_FPSX10				3			//ascii unit: ft/s x 10
+//4, 5: rpm / length on the ATmega8 build
+#define UNIT_JX10				6			//ascii unit: muzzle energy, J x 10
+#define UNIT_FTLBFX10			7			//ascii unit: muzzle energy, ft.lbf x 10
+#define UNIT_PFX10				8			//ascii unit: power factor x 10 (gr * fps / 1000)
+#define CFG_VER					3			//eeprom layout version. bump when chrono_cfg_t changes
+#if CHRONO_GATE2_SRC == GATE2_ACIC
+#define CHRONO2					CHRONO2_AIN1
+#else
+#define CHRONO2					CHRONO2_INT0
+#endif
 
 //port / pin macros
 #define IO_SET(port, pins)		port |= (pins)
@@ -57,26 +110,87 @@
 #define TIFR					TIFR1
 #define TIMSK					TIMSK1
 #define TICIE1					ICIE1
+#define SFIOR					ADCSRB		//ACME lives in ADCSRB on ATmega328
 
 //led indicators - active high
 #define LED_ON(LEDs)			IO_SET(LED_PORT, LEDs)
 #define LED_OFF(LEDs)			IO_CLR(LED_PORT, LEDs)
 
+//extended timestamp: tmr1 overflow count in the upper 16 bits, ICR1 / TCNT1 in the lower 16 bits
+typedef uint32_t chrono_ts_t;
+
+//capture record, passed from the capture isr to the main loop
+typedef struct {
+	uint32_t ticks;							//ticks elapsed between start / end
+	chrono_ts_t start;						//gate 1 time stamp, extended ticks
+	uint8_t seq;							//shot number, modulo 256. taken for dropped shots too -> gaps show on the host
+	uint8_t ps;								//tmr1 prescaler (TMR1PS_x)
+	uint8_t flags;							//CHRONO_F_x
+} chrono_rec_t;
+
+//run time configuration, kept in eeprom
+typedef struct {
+	uint8_t ver;							//CFG_VER
+	uint16_t distance;						//sensor distance, x10mm
+	uint8_t ps;								//tmr1 prescaler, TMR1PS_x
+	uint8_t trigger;						//leading edge at the pins: RISING / FALLING
+	uint8_t unit;							//ascii unit, UNIT_x
+	uint8_t osccal;							//OSCCAL, applied at power-up
+	uint16_t mass;							//projectile mass, grains x10
+	uint8_t skew;							//gate 2 lag behind gate 1 with GATE2_ACIC, cpu clocks
+	uint8_t crc;							//crc-8 of the bytes above
+} chrono_cfg_t;
+
 //global variables
-volatile uint16_t chrono_ticks=0;			//ticks elapsed between start / end
-volatile char chrono_available=0;			//data availability flag. 1=new data available, 0=no new data available
+chrono_cfg_t cfg;							//configuration in use
+chrono_cfg_t cfg_ee EEMEM;					//configuration in eeprom
+uint32_t cfg_kmps;							//distance * 1000 * ticks per us: mpsx10 = cfg_kmps / ticks, at the 1x prescaler
+uint32_t cfg_kq;							//cfg_kmps << cfg_vsh: vq = cfg_kq / ticks is mpsx10 in Q(cfg_vsh) fixed point
+uint8_t cfg_vsh;							//fraction bits of vq, 1..16: as many as cfg_kq holds
+uint8_t cfg_skew;							//cfg.skew in ticks of cfg.ps
+uint16_t cfg_lat;							//CHRONO_LAT_US in ticks of cfg.ps, at least 1
+char cfg_line[16];							//console command line being received
+uint8_t cfg_n=0;							//characters in cfg_line[]
+//single-producer (capture isr) / single-consumer (main loop) ring of capture records
+//free-running 8-bit indices: chrono_head is written by the isr only, chrono_tail by the main loop only
+volatile chrono_rec_t chrono_ring[CHRONO_RING];	//capture records
+volatile uint8_t chrono_head=0;				//next record to be written by the isr
+volatile uint8_t chrono_tail=0;				//next record to be read by the main loop
+volatile uint8_t chrono_ovf=0;				//records dropped because the ring was full
+volatile uint8_t chrono_state=CHRONO_IDLE;	//measurement state: CHRONO_IDLE -> CHRONO_ARMED -> CHRONO_COMPLETE
+volatile uint8_t chrono_timer=0;			//tmr1 overflows since gate 1 fired
+volatile uint8_t chrono_misses=0;			//shots abandoned because gate 2 never fired
+volatile uint8_t chrono_stray=0;			//gate 2 edges without a gate 1 edge
+volatile chrono_ts_t ticks=0;				//extended ticks, advanced by 0x10000 on each tmr1 overflow
+volatile uint8_t chrono_overruns=0;			//shots flagged CHRONO_F_OVERRUN
+volatile uint8_t chrono_seq=0;				//next shot number
+uint8_t tlm_ring[TLM_RING];					//telemetry bytes to be sent
+volatile uint8_t tlm_head=0;				//next byte to be written by the main loop
+volatile uint8_t tlm_tail=0;				//next byte to be sent by the udre isr
+uint8_t tlm_drops=0;						//shots not sent because the tx ring was full
+char tlm_text[TLM_TEXT];					//text line being put together by tlm_puts() / tlm_putu()
+uint8_t tlm_n=0;							//characters in tlm_text[]
+#if defined(CHRONO_STATS)
+#if CHRONO_STRING > STATS_NMAX
+#error "CHRONO_STRING: up to STATS_NMAX shots per string"
+#endif
+stats_t stats;								//statistics of the current string. main loop only
+#endif
+#if defined(CHRONO_SHIELD)
+static volatile uint8_t shield_on=0;		//1=udre interrupt masked
+static volatile uint8_t shield_uart;		//udre enable that was masked
+#endif
 
 //conversion routines
-//converting ticks to us
-uint32_t ticks2usx10(uint32_t ticks) {
-	switch (TCCR1B & 0x07) {
-		case TMR1PS_1x: ticks *= 1; break;	//1x prescaler
-		case TMR1PS_8x: ticks *= 8; break;	//8x prescaler
-		case TMR1PS_64x: ticks *= 64; break;
-		case TMR1PS_256x: ticks *= 256; break;
-		case TMR1PS_1024x: ticks *= 1024; break;
-	}
-	return ticks / (F_CPU / 1000000ul) * 10;		//return us
+//ps is the prescaler the ticks were taken with (rec.ps), not the one tmr1 runs on now: p can change it between shots
+//the prescaler is folded into the ticks with a shift -> one divide per conversion
+const uint8_t tmr1ps_shift[]={0, 0, 3, 6, 8, 10};	//log2 of the prescaler, indexed by TMR1PS_x. 0=tmr1 stopped
+
+//scale ticks of prescaler ps to 1x ticks. saturates: a saturated interval converts to 0 / full scale anyway
+uint32_t ticks2x1(uint32_t ticks, uint8_t ps) {
+	uint8_t sh = tmr1ps_shift[ps];
+
+	return (ticks > (0xfffffffful >> sh))?0xfffffffful:(ticks << sh);
 }
 
 //convert ticks to mpsx10 using floating point math
@@ -86,48 +200,502 @@ uint32_t ticks2mpsx10_fp(uint32_t ticks) {
 	//return (float) CHRONO_DISTANCE * 1000.0 * 10.0 / (float) ticks2usx10(ticks);
 }
 
-//convert ticks to meters per second x 10 (mpsx10) using integer math
-uint32_t ticks2mpsx10(uint32_t ticks) {
-	uint32_t tmp = (uint32_t) CHRONO_DISTANCE * 1000ul * (F_CPU / 1000000ul) / ticks;
-	switch (TCCR1B & 0x07) {
-		case TMR1PS_1x: tmp /= 1; break;
-		case TMR1PS_8x: tmp /= 8; break;
-		case TMR1PS_64x: tmp /= 64; break;
-		case TMR1PS_256x: tmp /= 256; break;
-		case TMR1PS_1024x: tmp /= 1024; break;
-	};
-	return tmp;
+//velocity in fixed point: vq = mpsx10 * 2^cfg_vsh. the one divide of the conversion pipeline
+//ticks are 1x ticks. the fraction bits let fpsx10 / mpsx10 round off the exact quotient
+uint32_t ticks2vq(uint32_t ticks) {
+	return cfg_kq / ticks;					//distance constant from cfg_apply()
+}
+
+//convert ticks to meters per second x 10 (mpsx10) using integer math, rounded
+uint32_t ticks2mpsx10(uint32_t ticks, uint8_t ps) {
+	return VQ_ROUND(ticks2vq(ticks2x1(ticks, ps)), cfg_vsh);
+}
+
+//muzzle energy and power factor, off vq and the projectile mass cfg.mass (grains x10). see vq.h
+uint32_t vq2energy(uint32_t vq, uint32_t ke) {
+	if (vq > VQ_MAX(cfg_vsh)) vq = VQ_MAX(cfg_vsh);
+	return VQ_ENERGY(vq, cfg_vsh, cfg.mass, ke);
+}
+
+uint32_t vq2pfx10(uint32_t vq) {
+	if (vq > VQ_MAX(cfg_vsh)) vq = VQ_MAX(cfg_vsh);
+	return VQ_PFX10(vq, cfg_vsh, cfg.mass);
 }
 
-//convert ticks to ft per second x 10 (fpsx10) using integer math
-uint32_t ticks2fpsx10(uint32_t ticks) {
-	return ticks2mpsx10(ticks) * 32804ul/10000;			//1meter = 3.28084
+//conversion pipeline: the units of a shot off one divide, ticks2vq()
+//only the units flagged in mask (UNIT_M(UNIT_x)) are worked out -> the display pays for the unit it shows
+//us: constant divisor, no divide. ft/s, energy, pf: multiplies off vq, not off the rounded m/s
+//each unit is rounded once, from vq / the ticks -> no truncation is carried from one unit into the next
+#define UNIT_M(unit)			(1u << (unit))	//mask bit of a unit
+#define UNIT_M_V				(UNIT_M(UNIT_MPSX10) | UNIT_M(UNIT_FPSX10) | UNIT_M(UNIT_JX10) | UNIT_M(UNIT_FTLBFX10) | UNIT_M(UNIT_PFX10))	//units off the velocity
+#define TICKS_US				(F_CPU / 1000000ul)	//ticks per us at the 1x prescaler
+
+typedef struct {
+	uint32_t usx10;							//interval, us x 10
+	uint32_t mpsx10, fpsx10;				//velocity. mpsx10 is worked out for any of the velocity units
+	uint32_t jx10, ftlbfx10, pfx10;			//energy / power factor
+} chrono_units_t;
+
+void chrono_units(chrono_units_t *u, uint32_t ticks, uint8_t ps, uint16_t mask) {
+	uint32_t vq;
+
+	ticks = ticks2x1(ticks, ps);
+	if (mask & UNIT_M(UNIT_USX10)) u->usx10 = ticks / TICKS_US * 10 + (ticks % TICKS_US * 10 + TICKS_US / 2) / TICKS_US;
+	if (!(mask & UNIT_M_V)) return;
+	vq = ticks2vq(ticks);					//the one divide
+	u->mpsx10 = VQ_ROUND(vq, cfg_vsh);
+	if (mask & UNIT_M(UNIT_FPSX10)) u->fpsx10 = VQ_FPSX10(vq, cfg_vsh);
+	if (mask & UNIT_M(UNIT_JX10)) u->jx10 = vq2energy(vq, KE_JX10);
+	if (mask & UNIT_M(UNIT_FTLBFX10)) u->ftlbfx10 = vq2energy(vq, KE_FTLBFX10);
+	if (mask & UNIT_M(UNIT_PFX10)) u->pfx10 = vq2pfx10(vq);
+}
+
+//push a record into the capture ring. called from the capture isr only. constant time
+//the record is written before chrono_head is advanced, so the main loop never sees a partial record
+static inline void chrono_push(uint32_t ticks, chrono_ts_t start, uint8_t flags) {
+	uint8_t head = chrono_head;
+	uint8_t seq = chrono_seq++;
+
+	if ((uint8_t) (head - chrono_tail) >= CHRONO_RING) {chrono_ovf += 1; return;}	//ring full -> count the loss
+	chrono_ring[head & (CHRONO_RING - 1)].ticks = ticks;
+	chrono_ring[head & (CHRONO_RING - 1)].start = start;
+	chrono_ring[head & (CHRONO_RING - 1)].seq = seq;
+	chrono_ring[head & (CHRONO_RING - 1)].ps = TCCR1B & 0x07;
+	chrono_ring[head & (CHRONO_RING - 1)].flags = flags;
+	if (flags & CHRONO_F_OVERRUN) chrono_overruns += 1;
+	chrono_head = head + 1;					//publish the record
+}
+
+//pop a record from the capture ring. called from the main loop only
+//return 1 if a record is retrieved, 0 if the ring is empty
+char chrono_pop(chrono_rec_t *rec) {
+	uint8_t tail = chrono_tail;
+
+	if (tail == chrono_head) return 0;		//ring empty
+	rec->ticks = chrono_ring[tail & (CHRONO_RING - 1)].ticks;	//field by field: c++ won't copy a volatile struct
+	rec->start = chrono_ring[tail & (CHRONO_RING - 1)].start;
+	rec->seq = chrono_ring[tail & (CHRONO_RING - 1)].seq;
+	rec->ps = chrono_ring[tail & (CHRONO_RING - 1)].ps;
+	rec->flags = chrono_ring[tail & (CHRONO_RING - 1)].flags;
+	chrono_tail = tail + 1;					//release the slot
+	return 1;
+}
+
+//form the extended timestamp of a tmr1 value (ICR1, or TCNT1 for INT0), read in a higher priority isr than TIMER1_OVF_vect
+//-> a pending TOV1 has not been counted in ticks yet: TS_EXTEND()
+//assumes the isr is serviced within 0x8000 ticks (2ms@16Mhz) of the edge. host test: test/tstamp_test.c
+static inline chrono_ts_t chrono_stamp(uint16_t tmr) {
+	chrono_ts_t msw = ticks;				//overflow count, after the tmr1 value
+
+	return TS_EXTEND(msw, tmr, TIFR & (1<<TOV1));
+}
+
+//telemetry: bytes go into tlm_ring[] and out of the uart from the udre isr. the main loop never waits on the uart
+//reset the uart: 8n1, U2X. rx is polled by the console
+void tlm_init(uint32_t baud) {
+	tlm_head = tlm_tail = 0;
+	UCSR0A = (1<<U2X0);						//double speed: finer baud steps, up to F_CPU / 8
+	UBRR0H = (F_CPU / 8 / baud - 1) >> 8;
+	UBRR0L = (F_CPU / 8 / baud - 1);
+	UCSR0C = (1<<UCSZ01) | (1<<UCSZ00);		//0b11->8 data bits, no parity, 1 stop bit
+	UCSR0B = (1<<TXEN0) | (1<<RXEN0);		//tx / rx on, udre interrupt off until there is data
+}
+
+//bytes free in the tx ring
+static inline uint8_t tlm_room(void) {
+	return TLM_RING - (uint8_t) (tlm_head - tlm_tail);
+}
+
+//queue a byte. the caller has checked tlm_room()
+static inline void tlm_put(uint8_t dat) {
+	uint8_t head = tlm_head;
+
+	tlm_ring[head & (TLM_RING - 1)] = dat;
+	tlm_head = head + 1;					//publish the byte
+#if defined(CHRONO_SHIELD)
+	//UCSR0B read-modify-write and the shield test in one go: a gate 1 in between would be unmasked again
+	cli();
+	if (shield_on) shield_uart |= (1<<UDRIE0);	//armed: the udre isr starts when gate 2 / the timeout unshields
+	else UCSR0B |= (1<<UDRIE0);				//1->udre isr sends it
+	sei();
+#else
+	UCSR0B |= (1<<UDRIE0);					//1->udre isr sends it
+#endif
+}
+
+//udre isr: next byte out, or off when the ring is empty
+ISR(USART_UDRE_vect) {
+	uint8_t tail = tlm_tail;
+
+	if (tail == tlm_head) {UCSR0B &=~(1<<UDRIE0); return;}	//nothing left to send
+	UDR0 = tlm_ring[tail & (TLM_RING - 1)];
+	tlm_tail = tail + 1;
+}
+
+//crc-8, polynomial 0x07 (x^8+x^2+x+1), initial value 0
+uint8_t crc8(uint8_t crc, uint8_t dat) {
+	uint8_t i;
+
+	crc ^= dat;
+	for (i=0; i<8; i++) crc = (crc & 0x80)?((crc << 1) ^ 0x07):(crc << 1);
+	return crc;
+}
+
+//add a string / a number to the text line. console replies and string reports only
+//nothing is queued until tlm_eol(): a line goes out whole or, past TLM_TEXT characters, cut short at the end
+void tlm_puts(const char *str) {
+	while (*str && (tlm_n < TLM_TEXT)) tlm_text[tlm_n++] = *str++;
+}
+
+void tlm_putu(uint32_t val) {
+	uint8_t dig[BCD32_DIGITS];
+	uint8_t n=0;
+
+	bcd32(val, dig);
+	while ((n < BCD32_DIGITS - 1) && (dig[n] == 0)) n++;	//no leading zeros
+	while ((n < BCD32_DIGITS) && (tlm_n < TLM_TEXT)) tlm_text[tlm_n++] = '0' + dig[n++];
+}
+
+//queue the text line, waiting for room in the tx ring: up to a frame time per byte, or until the shield lifts
+//TLM_ASCII: the line, <cr><lf>
+//binary: a text frame, sync(0xc6) len text[len] crc8 - crc over len .. text. the host tells it from a shot frame by the sync byte
+void tlm_eol(void) {
+	uint8_t i;
+#if defined(TLM_ASCII)
+	while (tlm_room() < tlm_n + 2) continue;
+	for (i=0; i<tlm_n; i++) tlm_put(tlm_text[i]);
+	tlm_put('\r'); tlm_put('\n');
+#else
+	uint8_t crc;
+
+	while (tlm_room() < tlm_n + 3) continue;
+	tlm_put(TLM_SYNC_TEXT);
+	tlm_put(tlm_n); crc = crc8(0, tlm_n);
+	for (i=0; i<tlm_n; i++) {crc = crc8(crc, tlm_text[i]); tlm_put(tlm_text[i]);}
+	tlm_put(crc);
+#endif
+	tlm_n = 0;
+}
+
+#if defined(TLM_ASCII)
+//queue a text line: [!]value<cr><lf>. value as picked in the main loop
+//return 0 if the tx ring has no room for the line
+char tlm_line(uint32_t val, uint8_t flags) {
+	uint8_t dig[BCD32_DIGITS];
+	uint8_t n=0, bang;
+
+	bcd32(val, dig);
+	while ((n < BCD32_DIGITS - 1) && (dig[n] == 0)) n++;	//no leading zeros
+	bang = (flags & CHRONO_F_OVERRUN)?1:0;	//suspect shot
+	if (tlm_room() < BCD32_DIGITS - n + bang + 2) return 0;
+	if (bang) tlm_put('!');
+	while (n < BCD32_DIGITS) tlm_put('0' + dig[n++]);
+	tlm_put('\r'); tlm_put('\n');
+	return 1;
+}
+#else
+//queue a binary frame, 13 bytes, multi-byte fields little endian:
+//	sync(0xc5) seq ticks[4] ps flags start[4] crc8
+//crc over seq .. start. 130us per frame at 1Mbaud
+//return 0 if the tx ring has no room for the frame
+char tlm_frame(chrono_rec_t *rec) {
+	uint8_t buf[11];
+	uint8_t i, crc=0;
+
+	if (tlm_room() < 13) return 0;
+	buf[0] = rec->seq;
+	buf[1] = rec->ticks; buf[2] = rec->ticks >> 8; buf[3] = rec->ticks >> 16; buf[4] = rec->ticks >> 24;
+	buf[5] = rec->ps;
+	buf[6] = rec->flags;
+	buf[7] = rec->start; buf[8] = rec->start >> 8; buf[9] = rec->start >> 16; buf[10] = rec->start >> 24;
+	tlm_put(TLM_SYNC);
+	for (i=0; i<11; i++) {crc = crc8(crc, buf[i]); tlm_put(buf[i]);}
+	tlm_put(crc);
+	return 1;
+}
+#endif
+
+//overrun check, right after the ICR1 read in a capture isr: ICF1 set again means another capture after the vector was
+//taken -> ICR1 may already hold the later edge. TCNT1 more than CHRONO_LAT_US past ICR1 means the isr was held off
+//longer than any on-time isr can -> a gate 2 edge may have been missed (gate not yet switched) in the meantime
+#define chrono_overrun(icr)		((TIFR & (1<<ICF1)) || ((uint16_t) (TCNT1 - (icr)) > cfg_lat))
+
+#if defined(CHRONO_SHIELD)
+//mask the udre interrupt: nothing but tmr1 between gate 1 and gate 2. the uart is the only other interrupt source
+//in this sketch: main() replaces the core's, so init() never starts the timer0 (millis) isr
+//isr context. called on gate 1
+static inline void chrono_shield(void) {
+	if (shield_on) return;					//masked already: keep the saved enable
+	shield_on = 1;
+	shield_uart = UCSR0B & (1<<UDRIE0);
+	UCSR0B &=~(1<<UDRIE0);
+}
+
+//restore it: the udre isr sends what was queued while armed
+//isr context. called on gate 2 and on timeout
+static inline void chrono_unshield(void) {
+	if (!shield_on) return;
+	shield_on = 0;
+	UCSR0B |= shield_uart;
+}
+#else
+#define chrono_shield()
+#define chrono_unshield()
+#endif
+
+#if CHRONO_GATE2_SRC == GATE2_ACIC
+//the gate that produced the edge in ICR1 is the one routed to the input capture unit: ACIC is the hardware tag
+#define chrono_gate()			((ACSR & (1<<ACIC))?CHRONO_GATE2:CHRONO_GATE1)
+
+//route a gate to the input capture unit, and set its active edge
+//gate 1: ICP1 pin directly (ACIC=0)
+//gate 2: analog comparator output (ACIC=1). bandgap on the positive input, AIN1 on the negative input
+//-> the comparator output is the inverted AIN1 pin, so is the edge
+static inline void chrono_sel(uint8_t gate) {
+	uint8_t edge = cfg.trigger;				//edge at the pins
+
+	if (gate == CHRONO_GATE1) ACSR &=~(1<<ACIC);
+	else {ACSR |= (1<<ACIC); edge ^= 1;}	//edge on ACO is the opposite of the edge on AIN1
+	if (edge == RISING) TCCR1B |= 0x40;		//ICES1=1->rising edge
+	else TCCR1B &=~0x40;					//ICES1=0->falling edge
+	TIFR = (1<<ICF1);						//changing ACIC / ICES1 may set ICF1 -> clear it
 }
 
 //tmr1 capture isr
 ISR(TIMER1_CAPT_vect) {
-	static uint16_t chrono_start, chrono_end;
-	static char chrono_ch=0;				//chrono input channel. 0=>put ICR1 into start, 1->put ICR1 input end
+	static chrono_ts_t chrono_start, chrono_end;
+	static uint8_t chrono_flags;			//flags of the shot under way
+	uint16_t icr = ICR1;					//read ICR1 first
+	uint8_t late = chrono_overrun(icr);
+	chrono_ts_t stamp = chrono_stamp(icr);	//extended ICR1
 
 	//clear the flag -> done automatically
-	if ((chrono_ch++ & 0x01)==0) {			//ch = 0 right now -> ICR1 to start
-		chrono_start = ICR1;				//save ICR1 to chrono_start
+	//start / stop is decided by the gate that produced the edge, not by counting edges
+	//a missed or spurious edge cannot swap later pairs
+	if (chrono_gate() == CHRONO_GATE1) {	//gate 1 -> ICR1 to start
+		chrono_start = stamp;				//save extended ICR1 to chrono_start
+		chrono_flags = late?CHRONO_F_OVERRUN:0;
+		chrono_timer = 0;					//start the timeout
+		chrono_state = CHRONO_ARMED;
+		chrono_sel(CHRONO_GATE2);			//now wait for gate 2
+		chrono_shield();
 		LED_OFF(LED_START);					//turn off the start led
-	} else {								//ch = 1 right now -> ICR1 to end
-		chrono_end = ICR1;					//save ICR1 to end
-		chrono_ticks = chrono_end - chrono_start;	//calculate ticks elapsed
-		chrono_available = 1;				//1->new data available
+	} else {								//gate 2 -> ICR1 to end
+		chrono_end = stamp - cfg_skew;		//save extended ICR1 to end, less the comparator delay
+		if (late) chrono_flags |= CHRONO_F_OVERRUN;
+		chrono_unshield();
+		chrono_push(chrono_end - chrono_start, chrono_start, chrono_flags);	//ticks elapsed, to the main loop
+		chrono_state = CHRONO_COMPLETE;
+		chrono_sel(CHRONO_GATE1);			//re-arm on gate 1
+		LED_OFF(LED_STOP); 					//turn off the stop led
+	}
+}
+#else
+//gate 1 owns ICP1, gate 2 owns INT0: both edges are tagged by the vector they arrive on
+static chrono_ts_t chrono_start;			//gate 1 time stamp
+static uint8_t chrono_flags;				//flags of the shot under way
+
+//tmr1 capture isr - gate 1 only
+//a gate 1 edge always (re)starts the measurement -> resynchronises on its own after a missed gate 2
+ISR(TIMER1_CAPT_vect) {
+	uint16_t icr = ICR1;					//read ICR1 first
+
+	//clear the flag -> done automatically
+	chrono_flags = chrono_overrun(icr)?CHRONO_F_OVERRUN:0;
+	chrono_start = chrono_stamp(icr);		//save extended ICR1 to chrono_start
+	chrono_timer = 0;						//start the timeout
+	chrono_state = CHRONO_ARMED;			//now wait for gate 2
+	chrono_shield();
+	LED_OFF(LED_START);						//turn off the start led
+}
+
+//int0 isr - gate 2 only
+//INTF0 latches the edge in hardware; the time stamp carries the (fixed) entry latency, taken out by CHRONO_INT0_LAT
+ISR(INT0_vect) {
+	chrono_ts_t chrono_end = chrono_stamp(TCNT1) - CHRONO_INT0_LAT;	//time stamp the edge first
+
+	//clear the flag -> done automatically
+	//INT0 outranks TIMER1_CAPT: pick up a gate 1 capture that is still pending
+	//TIFR is not re-checked for overrun: ICF1 is the pending capture itself
+	if (TIFR & (1<<ICF1)) {
+		uint16_t icr = ICR1;
+
+		chrono_start = chrono_stamp(icr);	//save extended ICR1 to chrono_start
+		TIFR = (1<<ICF1);					//1->clear the flag
+		chrono_flags = ((uint16_t) (TCNT1 - icr) > cfg_lat)?CHRONO_F_OVERRUN:0;
+		chrono_state = CHRONO_ARMED;
+	}
+	if (chrono_state == CHRONO_ARMED) {		//gate 2 -> end
+		chrono_state = CHRONO_COMPLETE;
+		chrono_unshield();
+		chrono_push(chrono_end - chrono_start, chrono_start, chrono_flags | CHRONO_F_INT0);	//ticks elapsed, to the main loop
 		LED_OFF(LED_STOP); 					//turn off the stop led
+	} else chrono_stray += 1;				//gate 2 without gate 1 -> ignore it
+}
+#endif
+
+//tmr1 overflow isr
+ISR(TIMER1_OVF_vect) {
+	//clear the flag - done automatically
+	ticks += 0x10000ul;						//tmr1 is 16-bit wide
+	//timeout: gate 2 missed -> abort the shot, count it as a miss and re-arm on gate 1. no reset needed
+	if ((chrono_state == CHRONO_ARMED) && (++chrono_timer >= CHRONO_TIMEOUT)) {
+#if CHRONO_GATE2_SRC == GATE2_ACIC
+		chrono_sel(CHRONO_GATE1);			//back to gate 1
+#endif
+		chrono_state = CHRONO_IDLE;
+		chrono_misses += 1;
+		chrono_unshield();
+		LED_ON(LED_START);					//ready to fire
+	}
+}
+
+//crc-8 of the configuration, crc field excluded
+uint8_t cfg_crc(chrono_cfg_t *c) {
+	uint8_t *p = (uint8_t *) c;
+	uint8_t i, crc=0;
+
+	for (i=0; i<sizeof(chrono_cfg_t) - 1; i++) crc = crc8(crc, p[i]);
+	return crc;
+}
+
+//work out the per-shot constants from the configuration -> the conversions only divide
+void cfg_apply(void) {
+	uint16_t lat;
+	uint8_t sreg;
+
+	cfg_kmps = (uint32_t) cfg.distance * 1000ul * (F_CPU / 1000000ul);
+	VQ_SHIFT(cfg_vsh, cfg_kmps);			//largest shift that fits 32 bits
+	cfg_kq = cfg_kmps << cfg_vsh;
+	cfg_skew = ((uint16_t) cfg.skew + ((1u << tmr1ps_shift[cfg.ps]) >> 1)) >> tmr1ps_shift[cfg.ps];	//rounded
+	lat = (CHRONO_LAT_US * (F_CPU / 1000000ul)) >> tmr1ps_shift[cfg.ps];
+	sreg = SREG; cli();						//16 bits, read by the capture isrs
+	cfg_lat = (lat < 1)?1:lat;
+	SREG = sreg;
+}
+
+//load the configuration from eeprom. wrong version or crc -> the compile-time defaults
+void cfg_load(void) {
+	eeprom_read_block(&cfg, &cfg_ee, sizeof(cfg));
+	if ((cfg.ver != CFG_VER) || (cfg.crc != cfg_crc(&cfg))) {
+		cfg.ver = CFG_VER;
+		cfg.distance = CHRONO_DISTANCE;
+		cfg.ps = CHRONO_PS;
+		cfg.trigger = CHRONO_TRIGGER;
+		cfg.unit = CHRONO_UNIT;
+		cfg.mass = CHRONO_MASS;
+		cfg.skew = CHRONO_SKEW2;
+#if defined(OSCCAL_CAL)
+		cfg.osccal = OSCCAL_CAL;
+#else
+		cfg.osccal = OSCCAL;				//factory value
+#endif
+	}
+	cfg_apply();
+}
+
+//save the configuration to eeprom. unchanged bytes are not rewritten
+void cfg_save(void) {
+	cfg.ver = CFG_VER;
+	cfg.crc = cfg_crc(&cfg);
+	eeprom_update_block(&cfg, &cfg_ee, sizeof(cfg));
+}
+
+//report the configuration: d<distance> p<prescaler> t<trigger> u<unit> o<osccal> m<mass> k<skew>
+void cfg_report(void) {
+	tlm_puts("d"); tlm_putu(cfg.distance);
+	tlm_puts(" p"); tlm_putu(cfg.ps);
+	tlm_puts(" t"); tlm_putu(cfg.trigger);
+	tlm_puts(" u"); tlm_putu(cfg.unit);
+	tlm_puts(" o"); tlm_putu(cfg.osccal);
+	tlm_puts(" m"); tlm_putu(cfg.mass);
+	tlm_puts(" k"); tlm_putu(cfg.skew);
+	tlm_eol();
+}
+
+#if defined(CHRONO_STATS)
+//report the string: n<shots> a<mean> s<sd> e<es> l<min> h<max>, x10 like the values in cfg.unit
+void stats_report(void) {
+	tlm_puts("n"); tlm_putu(stats.n);
+	tlm_puts(" a"); tlm_putu(stats_mean(&stats));
+	tlm_puts(" s"); tlm_putu(stats_sd(&stats));
+	tlm_puts(" e"); tlm_putu(stats_es(&stats));
+	tlm_puts(" l"); tlm_putu(stats.min);
+	tlm_puts(" h"); tlm_putu(stats.max);
+	tlm_eol();
+}
+#endif
+
+void chrono_init(void);
+
+//execute a command line: a letter, then a decimal number where needed
+//	d1234	sensor distance, x10mm		p1..5	tmr1 prescaler, TMR1PS_x	t0/1	leading edge, RISING/FALLING
+//	u0..3/6..8	ascii unit, UNIT_x		o0..255	OSCCAL, from the next power-up
+//	m1470	projectile mass, grains x10	g9525	projectile mass, mg
+//	k0..255	gate 2 lag, cpu clocks, GATE2_ACIC
+//	?		report						w		save to eeprom
+//	s		string report, CHRONO_STATS	r		new string
+//p / t restart the chrono. replies are text lines, in text frames between the shot frames in binary mode
+void cfg_cmd(char *str) {
+	char cmd = *str++;
+	char ok = 1;
+	uint32_t val = 0;
+
+	while (*str == ' ') str++;
+	if ((*str < '0') || (*str > '9')) ok = (cmd == '?') || (cmd == 'w') || (cmd == 's') || (cmd == 'r');	//only those go without a number
+	while ((*str >= '0') && (*str <= '9') && (val < 100000ul)) val = val * 10 + (*str++ - '0');
+	if (ok) switch (cmd) {
+		case 'd': if ((val > 0) && (val <= 0xffff)) cfg.distance = val; else ok = 0; break;
+		case 'p': if ((val >= TMR1PS_1x) && (val <= TMR1PS_1024x)) cfg.ps = val; else ok = 0; break;
+		case 't': if (val <= FALLING) cfg.trigger = val; else ok = 0; break;
+		case 'u': if ((val <= UNIT_FPSX10) || ((val >= UNIT_JX10) && (val <= UNIT_PFX10))) cfg.unit = val; else ok = 0; break;
+		case 'm': if ((val > 0) && (val <= 0xffff)) cfg.mass = val; else ok = 0; break;
+		case 'g': val = ((uint64_t) val * 10114 + 0x8000) >> 16;	//mg -> grains x10
+			if ((val > 0) && (val <= 0xffff)) cfg.mass = val; else ok = 0; break;
+		case 'o': if (val <= 0xff) cfg.osccal = val; else ok = 0; break;
+		case 'k': if (val <= 0xff) cfg.skew = val; else ok = 0; break;
+		case 'w': cfg_save(); break;
+		case '?': break;
+#if defined(CHRONO_STATS)
+		case 's': stats_report(); return;
+		case 'r': break;
+#endif
+		default: ok = 0; break;
 	}
+	if (!ok) {tlm_puts("?"); tlm_eol(); return;}
+	cfg_apply();
+#if defined(CHRONO_STATS)
+	if ((cmd != '?') && (cmd != 'w')) stats_reset(&stats);	//new setup: a new string
+#endif
+	if ((cmd == 'p') || (cmd == 't')) {cli(); chrono_init(); sei();}	//new prescaler / edges: re-arm from scratch
+	cfg_report();
+}
+
+//console: collect a line from the uart, polled from the main loop. one character per call at most
+//1Mbaud is 10us per character: type, don't paste
+void cfg_poll(void) {
+	char ch;
+
+	if (!(UCSR0A & (1<<RXC0))) return;		//nothing received
+	ch = UDR0;
+	if ((ch == '\r') || (ch == '\n')) {
+		cfg_line[cfg_n] = 0;
+		if (cfg_n) cfg_cmd(cfg_line);
+		cfg_n = 0;
+	} else if (cfg_n < sizeof(cfg_line) - 1) cfg_line[cfg_n++] = ch;
 }
 
 //reset the chrono
-//tmr1 free running, no overflow interrupt
+//tmr1 free running, overflow interrupt extends it to 32 bits
 //ICP1 at 1x sampling.
 void chrono_init(void) {
 	//reset chrono variables
-	chrono_ticks = 0;
-	chrono_available = 0;					//no new data
+	ticks = 0;
+	chrono_head = chrono_tail = 0;			//empty the capture ring
+	chrono_ovf = 0;
+	chrono_state = CHRONO_IDLE;				//ready to fire
+	chrono_timer = chrono_misses = chrono_stray = 0;
+	chrono_overruns = 0;
 
 	//set up the indicators
 	//led_start / _stop as output, on
@@ -137,6 +705,8 @@ void chrono_init(void) {
 	//chrono input pin as input, with pull-up enabled
 	IO_IN(CHRONO_DDR, CHRONO); 				//pin as input
 	IO_SET(CHRONO_PORT, CHRONO);			//enable pull-up
+	IO_IN(CHRONO2_DDR, CHRONO2);			//gate 2 pin as input
+	IO_SET(CHRONO2_PORT, CHRONO2);			//enable pull-up
 
 	//configure tmr1 as free-running, 1x prescaler
 	//TCCR1A = TCCR1B = 0;
@@ -148,21 +718,50 @@ void chrono_init(void) {
 	//configure input capture on ICP1/PB0
 	//disable noise filter -> capture on the first edge
 	TCCR1B = (TCCR1B & ~0x80) | (0x00 & 0x80);
-#if CHRONO_TRIGGER == RISING
-	TCCR1B = (TCCR1B & ~0x40) | (0x40 & 0x40);	//1->rising edge
+#if CHRONO_GATE2_SRC == GATE2_ACIC
+	//analog comparator on, bandgap (1.1v) on the positive input, AIN1 on the negative input
+	//comparator interrupt off, not yet routed to input capture
+	SFIOR &=~(1<<ACME);						//0->AIN1 is the negative input
+	ACSR = (0<<ACD) | (1<<ACBG) | (0<<ACIE) | (0<<ACIC);
+	chrono_sel(CHRONO_GATE1);				//armed on gate 1, edge per cfg.trigger
 #else
-	TCCR1B = (TCCR1B & ~0x40) | (0x00 & 0x40);	//0->falling edge
+	if (cfg.trigger == RISING) {
+		TCCR1B = (TCCR1B & ~0x40) | (0x40 & 0x40);	//1->rising edge
+		EICRA = (EICRA & ~0x03) | (0x03 & 0x03);	//0b11->INT0 on rising edge
+	} else {
+		TCCR1B = (TCCR1B & ~0x40) | (0x00 & 0x40);	//0->falling edge
+		EICRA = (EICRA & ~0x03) | (0x02 & 0x03);	//0b10->INT0 on falling edge
+	}
+	EIFR = (1<<INTF0);						//1->clear the flag
+	EIMSK |= (1<<INT0);						//1->enable int0
 #endif
 
 	//enable tmr1 input capture interrupt
-	TIFR |= (1<<ICF1);						//1->clear the flag
-	TIMSK |= (1<<TICIE1);					//1->enable the input capture interrupt
+	TIFR |= (1<<ICF1) | (1<<TOV1);			//1->clear the flag
+	TIMSK |= (1<<TICIE1) | (1<<TOIE1);		//1->enable the input capture and (timeout) overflow interrupts
 
 	//start tmr1
-	TCCR1B = (TCCR1B & ~0x07) | (CHRONO_PS & 0x07);	//start timer on 1x prescaler
+	TCCR1B = (TCCR1B & ~0x07) | (cfg.ps & 0x07);	//start timer on the configured prescaler
 }
 
 
+//the value of a record in cfg.unit. only that unit is worked out
+uint32_t chrono_value(chrono_rec_t *rec) {
+	chrono_units_t val;
+
+	chrono_units(&val, rec->ticks, rec->ps, UNIT_M(cfg.unit));
+	switch (cfg.unit) {
+		default:
+		case UNIT_TICKS: return rec->ticks;
+		case UNIT_USX10: return val.usx10;							//1000 ticks@8Mhz -> 125us
+		case UNIT_MPSX10: return val.mpsx10;						//123.4mm/125us=987.2. rounded
+		case UNIT_FPSX10: return val.fpsx10;						//987.2mps->3238.8. rounded off vq, not off mpsx10
+		case UNIT_JX10: return val.jx10;							//147.0gr@987.2mps -> 4641.5J
+		case UNIT_FTLBFX10: return val.ftlbfx10;					//-> 3423.4ft.lbf
+		case UNIT_PFX10: return val.pfx10;							//-> pf 476.1
+	}
+}
+
 //reset the mcu
 void mcu_init(void) {
 	//reset the mcu
@@ -174,14 +773,14 @@ void mcu_init(void) {
 
 int main(void) {
 	uint32_t tmp;							//number to be displayed
+	chrono_rec_t rec;						//capture record
 	char tmp1, dp;							//dp = decimal point, =2(digit 3) or 3(digit 4)
 	uint16_t cnt=0;							//counter
 
 	mcu_init();								//reset the mcu
 
-#if defined(OSCCAL_CAL)
-	OSCCAL = OSCCAL_CAL;					//calibration for Internal RC oscillator
-#endif
+	cfg_load();								//configuration from eeprom, or the defaults
+	OSCCAL = cfg.osccal;					//calibration for Internal RC oscillator. no effect on a crystal
 	//led_init();								//reset the led
 	chrono_init();							//reset the chrono
 
@@ -189,7 +788,7 @@ int main(void) {
 	IO_OUT(DEBUG_DDR, DEBUG_PIN);
 #endif
 
-	Serial.begin(9600);						//initialize the serial for print
+	tlm_init(TLM_BAUD);						//telemetry out on TXD (D1)
 
 	ei();									//enable global interrupt
 	while(1) {
@@ -207,17 +806,22 @@ int main(void) {
 #endif
 
 
-		//convert chrono_ticks only if the data is new
-		//chrono_available=1;
-		if (chrono_available) {
-			chrono_available = 0;
-			//chrono_ticks = 1000;								//for debugging only - to make sure that the math is correct
-			//pick the variable to display
-			tmp = chrono_ticks;
-			//tmp = ticks2usx10(chrono_ticks);					//1000 ticks@8Mhz -> 125us
-			//tmp = ticks2mpsx10_fp(chrono_ticks);				//123.4mm/125us=987.2, displayed as 987.2. very minor flickering at 1Mhz
-			//tmp = ticks2mpsx10(chrono_ticks);					//123.4mm/125us=987.2, displayed as 987. no flickering at 1Mhz. with rouding.
-			//tmp = ticks2fpsx10(chrono_ticks);					//987.2mps->3238.845, displayed as 3238. no flickering at 1Mhz. with rouding.
+#if defined(CHRONO_SHIELD)
+		if (chrono_state == CHRONO_ARMED) continue;	//nothing to send while armed: the uart is masked
+#endif
+		cfg_poll();							//console
+		//drain the capture ring in one batch. every record is queued for the uart
+		while (chrono_pop(&rec)) {
+			//rec.ticks = 1000;									//for debugging only - to make sure that the math is correct
+#if defined(CHRONO_STATS) || defined(TLM_ASCII)
+			tmp = chrono_value(&rec);							//pick the variable, per cfg.unit
+#endif
+#if defined(CHRONO_STATS)
+			//every shot goes into the string. main loop only: the capture isr is untouched
+			if (stats.n >= CHRONO_STRING) stats_reset(&stats);	//the last string is complete: a new one
+			stats_add(&stats, tmp);
+#endif
+#if defined(TLM_ASCII)
 			if (tmp > 99999 - 5) {tmp = 99999 - 5;}				//bound tmp, dp on digit 4. "5" here for rounding
 #if defined(CHRONO_DP)
 			//decide where the decimal point should be, digit 3 or digit 4
@@ -228,7 +832,13 @@ int main(void) {
 #endif
 			//display tmp by forming the string in display buffer lRAM[]
 			//display routine here
-			Serial.println(tmp);
+			if (!tlm_line(tmp, rec.flags)) tlm_drops += 1;
+#else
+			if (!tlm_frame(&rec)) tlm_drops += 1;				//raw record; the host does the math
+#endif
+#if defined(CHRONO_STATS)
+			if (stats.n >= CHRONO_STRING) stats_report();		//last shot of the string: its statistics follow its line / frame
+#endif
 
 			LED_ON(LED_START | LED_STOP);						//turn on both leds to indicate ready to fire status
 		}
@@ -0,0 +1,40 @@
+/*
+ * File:   vq.h
+ *
+ * velocity in fixed point: vq = mpsx10 * 2^sh, sh fraction bits, off one divide vq = (k << sh) / ticks
+ * k is the distance constant, mpsx10 = k / ticks: distance in mm x 1000 x ticks per us at the 1x prescaler
+ */
+
+#ifndef VQ_H
+#define	VQ_H
+
+//sh = the largest shift, 16 down to 1, that keeps k << sh in 32 bits. a statement
+#define VQ_SHIFT(sh, k)			for ((sh) = 16; ((sh) > 1) && ((k) >> (32 - (sh))); (sh)--) continue
+
+//vq -> mpsx10, rounded. sh >= 1
+#define VQ_ROUND(vq, sh)		((((vq) >> ((sh) - 1)) + 1) >> 1)
+
+//vq -> fpsx10, rounded off vq, not off the rounded mpsx10
+#define KFPS_Q24				55043361ull	//3.28084 * 2^24: fpsx10 = mpsx10 * 3.28084
+#define VQ_FPSX10(vq, sh)		(((((uint64_t) (vq) * KFPS_Q24) >> ((sh) + 23)) + 1) >> 1)
+
+//muzzle energy and power factor off vq and the projectile mass grx10 (grains x10), rounded
+//64-bit fixed point, multiplies and shifts only - no float:
+//	jx10     = grx10 * mpsx10^2 * 3.2399455e-7		0.1gr = 6.479891mg, E = m v^2 / 2
+//	ftlbfx10 = jx10 / 1.3558179
+//	pfx10    = grx10 * mpsx10 * 3.28084e-4			pf = gr * fps / 1000
+//vq up to VQ_MAX(sh) (mpsx10 0xffff), 16-bit grx10: every product stays under 2^64
+#define KE_SH					37			//energy constants, x 2^37
+#define KE_JX10					44529ull	//3.2399455e-7 * 2^37
+#define KE_FTLBFX10				32843ull	//3.2399455e-7 / 1.3558179 * 2^37
+#define KPF_SH					32			//power factor constant, x 2^32
+#define KPF_PFX10				1409110ull	//3.28084e-4 * 2^32
+#define VQ_MAX(sh)				(0xfffful << (sh))	//clamp vq to this first
+
+//grx10 * ke * vq is under 2^(48 + sh). 2 * sh bits off, then times vq again: under 2^64. the cut costs < 1/32 count
+#define VQ_ENERGY(vq, sh, grx10, ke)	((((((uint64_t) (grx10) * (ke) * (vq)) >> (2 * (sh))) * (vq)) + (1ull << (KE_SH - 1))) >> KE_SH)
+//vq cut to 11 fraction bits at most: grx10 * vq * KPF_PFX10 stays under 2^64
+#define VQ_PFSH(sh)				(((sh) > 11)?11:(sh))
+#define VQ_PFX10(vq, sh, grx10)	(((uint64_t) (grx10) * ((vq) >> ((sh) - VQ_PFSH(sh))) * KPF_PFX10 + (1ull << (KPF_SH + VQ_PFSH(sh) - 1))) >> (KPF_SH + VQ_PFSH(sh)))
+
+#endif	/* VQ_H */
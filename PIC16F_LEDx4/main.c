@@ -2,57 +2,158 @@
 #include "gpio.h"                           //we use gpio functions
 #include "delay.h"                          //we use software delays
 #include "led4_pins.h"						//led display routines
-#include "tmr0.h"							//driving led - not used
+#include "bcd.h"							//binary to bcd conversion
+#include "tmr0.h"							//driving led
 #include "tmr1.h"							//chrono timer -> configured as systick timer
 
 
 //hardware configuration
 #define CHRONO_DLY				1			//delay
-#define CHRONO_START			(1<<0)		//chrono starts on rising edge of PB0
-#define CHRONO_END				(1<<7)		//chrono ends on rising edge of PB7
+//#define CHRONO_IOC							//define CHRONO_IOC to time stamp PB0/PB7 in the ioc isr instead of capturing on ccp1/ccp2
+//time stamp jitter, tmr1 @ 16Mhz = 4 ticks per instruction:
+//ccp: latched by the hardware -> 1 tick (62.5ns) per stamp, independent of the isr latency
+//ioc: read from tmr1 in the isr -> isr entry latency of 3-5 instructions per the datasheet -> 8 ticks (0.5us) spread per stamp,
+//     up to 1us on an elapsed time (0.1% of a 1ms flight), plus up to led_busy when the edge arrives during a display refresh
+#if defined(CHRONO_IOC)
+#define CHRONO_DDR				TRISB
+#define CHRONO_PORT				LATB
+#define CHRONO_START			(1<<0)		//chrono starts on PB0
+#define CHRONO_END				(1<<7)		//chrono ends on PB7
+//#define CHRONO_CAL							//define CHRONO_CAL to measure the latency of each ioc path at boot, by striking the gate pins as outputs. sensors disconnected
+#define CHRONO_CAL_N			16			//strikes per path. power of 2
+#define CHRONO_SKEW				0			//end path latency - start path latency, in ticks, without CHRONO_CAL
+#else
+#define CHRONO_DDR				TRISC		//RC2/CCP1/CHRONO_START, RC1/CCP2/CHRONO_END
+#define CHRONO_START			(1<<2)		//RC2/CCP1/CHRONO_START
+#define CHRONO_END				(1<<1)		//RC1/CCP2/CHRONO_END
+#endif
 #define CHRONO_TRIGGER			FALLING		//chrono-trigger: RISING/FALLING
 #define systicks()				TMR1		//systicks mapped to TMR1 -> short overflow
 
+#define CHRONO_RING				8			//capture ring size, in records. power of 2, up to 128
+
+#define LED_PS					TMR0_PS_16x	//display refresh: one digit per tmr0 overflow, every 256*16 instructions -> 977Hz/digit, 244Hz/frame@4Mhz F_CPU
+//#define LED_STATS							//define LED_STATS to time the display isr with tmr1 -> led_period / led_busy, read them with the debugger
+
 #define RISING					0
 #define FALLING					1
 //end hardware configuration
 
+//ccp capture modes
+#define CCP_RISING				0x05		//0b0101->capture on every rising edge
+#define CCP_FALLING				0x04		//0b0100->capture on every falling edge
+#if CHRONO_TRIGGER == RISING
+#define CCP_LEAD				CCP_RISING	//leading edge of a shadow pulse
+#else
+#define CCP_LEAD				CCP_FALLING
+#endif
+
 //global defines
+//capture record, passed from the isr to the main loop
+typedef struct {
+	uint16_t ticks;							//ticks elapsed between start / end
+} chrono_rec_t;
 
 //global variables
 //volatile uint16_t systicks_msw=0;			//16-bit systick msw
 //volatile uint32_t systicks=0;				//systicks
 //char lRAM[4];								//display buffer - declared in led4_pins
-volatile uint16_t chrono_ticks=0;
-volatile char chrono_available=0;			//1=new data available in chrono_ticks, 0=no new data
+//single-producer (isr) / single-consumer (main loop) ring of capture records
+//free-running 8-bit indices: chrono_head is written by the isr only, chrono_tail by the main loop only
+volatile chrono_rec_t chrono_ring[CHRONO_RING];	//capture records
+volatile uint8_t chrono_head=0;				//next record to be written by the isr
+volatile uint8_t chrono_tail=0;				//next record to be read by the main loop
+volatile uint8_t chrono_ovf=0;				//records dropped because the ring was full
+#if defined(CHRONO_IOC)
+//latency compensation: both paths stamp tmr1 at isr entry, and the calibrated skew between them is taken off each elapsed time
+volatile uint16_t ioc_stamp[2];				//last raw time stamps of the start / end paths
+volatile uint8_t ioc_hits[2];				//time stamps taken on the start / end paths
+int16_t ioc_skew=CHRONO_SKEW;				//end path latency - start path latency, ticks
+uint16_t ioc_lat[2];						//mean latency of the start / end paths, ticks. set by chrono_cal()
+uint16_t ioc_jit[2];						//latency spread (max - min) of the start / end paths, ticks. set by chrono_cal()
+#endif
+#if defined(LED_STATS)
+//refresh rate = 16Mhz / (4 * led_period) frames/s; isr duty cycle = led_busy / led_period
+//led_busy covers led_display() only, not the isr entry / exit
+volatile uint16_t led_period=0;				//tmr1 ticks between the last two display interrupts. 16384 expected
+volatile uint16_t led_busy=0;				//tmr1 ticks spent in the longest display refresh so far
+#endif
 
 //prototypes
 //uint32_t systicks(void);
 
+//push a record into the capture ring. called from the isr only. constant time
+//the record is written before chrono_head is advanced, so the main loop never sees a partial record
+void chrono_push(uint16_t ticks) {
+	uint8_t head = chrono_head;
+
+	if ((uint8_t) (head - chrono_tail) >= CHRONO_RING) {chrono_ovf += 1; return;}	//ring full -> count the loss
+	chrono_ring[head & (CHRONO_RING - 1)].ticks = ticks;
+	chrono_head = head + 1;					//publish the record
+}
+
+//pop a record from the capture ring. called from the main loop only
+//return 1 if a record is retrieved, 0 if the ring is empty
+char chrono_pop(chrono_rec_t *rec) {
+	uint8_t tail = chrono_tail;
+
+	if (tail == chrono_head) return 0;		//ring empty
+	*rec = chrono_ring[tail & (CHRONO_RING - 1)];
+	chrono_tail = tail + 1;					//release the slot
+	return 1;
+}
+
 //global isr
 void interrupt isr(void) {
 	static uint16_t ticks_start, ticks_end;
-	//tmr1 isr
-	//if (TMR1IF) {
-	//	TMR1IF = 0;								//clear the flag
-	//	systicks_msw+=1;						//advance the msw
-	//}	
-	
+#if defined(CHRONO_IOC)
+	uint16_t now = systicks();				//time stamp first, before the flag checks -> the same latency on both paths
+
 	//IOC interrupt isr
 	if (IOCIF) {
 		IOCIF = 0;							//clera the flag
 		if (IOCBF & CHRONO_START) {			//chrono to start
 			IOCBF ^= CHRONO_START;			//clear the flag
-			ticks_start = systicks();		//time stamp ticks_start
+			ticks_start = now;				//time stamp ticks_start
+			ioc_stamp[0] = now; ioc_hits[0] += 1;
 		}
 		
 		if (IOCBF & CHRONO_END) {			//chrono to end
 			IOCBF ^= CHRONO_END;			//clear the flag
-			ticks_end = systicks();			//time stamp ticks_end
-			chrono_ticks = ticks_end - ticks_start;	//calculate time elapsed
-			chrono_available = 1;			//1=new data available
+			ticks_end = now;				//time stamp ticks_end
+			ioc_stamp[1] = now; ioc_hits[1] += 1;
+			chrono_push(ticks_end - ticks_start - ioc_skew);	//time elapsed, latency compensated, to the main loop
 		}
-	}		
+	}
+#else
+	//CCP interrupt isr. the time stamps are latched by the ccps: the isr latency does not matter
+	if (CCP1IF) {
+		CCP1IF = 0;							//clear the flag
+		ticks_start = CCPR1;				//record the timebase
+	}
+
+	if (CCP2IF) {
+		CCP2IF = 0;							//clear the flag
+		ticks_end = CCPR2;					//record the time base
+		chrono_push(ticks_end - ticks_start);	//time elapsed, to the main loop
+	}
+#endif
+
+	//tmr0 isr - display refresh, one digit per interrupt. with CHRONO_IOC, an edge during the refresh
+	//is time stamped late, by up to led_busy ticks
+	if (TMR0IF) {
+#if defined(LED_STATS)
+		static uint16_t led_prev;
+		uint16_t t0 = TMR1, t1;
+
+		tmr0_isr();							//clear the flag, run led_display()
+		t1 = TMR1;
+		led_period = t0 - led_prev; led_prev = t0;
+		if ((uint16_t) (t1 - t0) > led_busy) led_busy = t1 - t0;
+#else
+		tmr0_isr();							//clear the flag, run led_display()
+#endif
+	}
 }
 
 #if 0
@@ -72,7 +173,8 @@ uint32_t systicks(void) {
 //initialize the chrono
 void chrono_init(void) {
 	//no new data
-	chrono_available = 0;					//no new data available
+	chrono_head = chrono_tail = 0;			//empty the capture ring
+	chrono_ovf = 0;
 	
 	//set up tmr1
 	tmr1_init(TMR1_PS1x, 0);				//configured as free-running 16-bit timer @ 1x prescaler
@@ -81,6 +183,10 @@ void chrono_init(void) {
 	TMR1IE = 0;								//tmr1 interrupt off -> max timing is 0xffff* prescaler
 	//tmr1 is now running freely
 	
+	//initialize the CHRONO_START/_END as input pins
+	IO_IN(CHRONO_DDR, CHRONO_START | CHRONO_END);
+
+#if defined(CHRONO_IOC)
 	//set up external interrupts
 #if CHRONO_TRIGGER == RISING
 	IO_SET(IOCBP, CHRONO_START | CHRONO_END); IO_CLR(IOCBN, CHRONO_START | CHRONO_END);		//trigger on positive edge on chrono_start and _end pins
@@ -89,32 +195,111 @@ void chrono_init(void) {
 #endif
 	IOCIF = 0;								//clear the flag
 	IOCIE = 1;								//enable the isr
+#else
+	//set up timer capture ccp1/CHRONO_START. capture always runs off tmr1
+	CCP1IE = 0;								//disable interrupt while being configured
+	CCP1CON = CCP_LEAD;						//leading edge, per CHRONO_TRIGGER
+	CCP1IF = 0;								//clear the flag
+	CCP1IE = 1;								//enable ccp1 interrupt
+
+	//set up timer capture ccp2/CHRONO_END, on RC1 with APFCON's default
+	CCP2IE = 0;								//disable interrupt while being configured
+	CCP2CON = CCP_LEAD;						//leading edge, per CHRONO_TRIGGER
+	CCP2IF = 0;								//clear the flag
+	CCP2IE = 1;								//enable ccp2 interrupt
+#endif
 
 	PEIE = 1;								//peripheral interrupt on
 }
 
+#if defined(CHRONO_CAL)
+//measure the latency of the ioc paths: strike each gate pin as an output, CHRONO_CAL_N times
+//latency = isr time stamp - tmr1 just before the strike. the display refresh is held off meanwhile
+//the common part (strike -> isr entry) cancels out in the elapsed times; the skew between the paths does not
+//and is taken off them. global interrupts must be on
+void chrono_cal(void) {
+	uint8_t path, i, n, t0ie = T0IE;
+	uint8_t pin;
+	uint16_t t, lat, min, max, wait;
+	uint32_t sum;
+
+	T0IE = 0;								//no display refresh
+	for (path = 0; path < 2; path++) {
+		pin = path ? CHRONO_END : CHRONO_START;
+		sum = 0; min = 0xffff; max = 0;
+#if CHRONO_TRIGGER == RISING
+		IO_CLR(CHRONO_PORT, pin);			//idle low
+#else
+		IO_SET(CHRONO_PORT, pin);			//idle high
+#endif
+		IO_OUT(CHRONO_DDR, pin);
+		for (i = 0; i < CHRONO_CAL_N; i++) {
+			delay_us(100);					//settle
+			n = ioc_hits[path];
+			t = systicks();
+			IO_FLP(CHRONO_PORT, pin);		//strike: the trigger edge
+			for (wait = 0; (ioc_hits[path] == n) && (wait < 1000); wait++) continue;	//wait for the isr
+			IO_FLP(CHRONO_PORT, pin);		//back to idle
+			if (ioc_hits[path] == n) break;	//no isr -> calibration failed, keep CHRONO_SKEW
+			lat = ioc_stamp[path] - t;
+			sum += lat;
+			if (lat < min) min = lat;
+			if (lat > max) max = lat;
+		}
+		IO_IN(CHRONO_DDR, pin);
+		if (i < CHRONO_CAL_N) break;
+		ioc_lat[path] = sum / CHRONO_CAL_N;
+		ioc_jit[path] = max - min;
+	}
+	if (path == 2) ioc_skew = ioc_lat[1] - ioc_lat[0];	//both paths calibrated
+
+	//discard the records from the strikes
+	di(); chrono_head = chrono_tail = 0; chrono_ovf = 0; ei();
+	T0IE = t0ie;
+}
+#endif
+
+//set up the periodic display refresh on tmr0
+void led_refresh(void) {
+	tmr0_init(LED_PS);						//tmr0 counts Fosc/4 through the prescaler, overflows every 256 counts
+	tmr0_act(led_display);					//led_display() runs from the tmr0 isr
+}
+
 int main(void) {
 	uint16_t tmp;							//4-digit display variable
+	uint8_t dig[BCD16_DIGITS];				//digits of tmp, most significant first
+	chrono_rec_t rec;						//capture record
+	char rec_new;							//1=new records drained this pass
 	
 	mcu_init();							    //initialize the mcu, 16Mhz
 	
 	//set up led display
 	led_init();								//reset the led
+	led_refresh();							//refresh the led from the tmr0 isr
 	chrono_init();							//reset the chrono
 	
 	ei();									//enable global interrupts
+#if defined(CHRONO_CAL)
+	chrono_cal();							//measure the ioc path latencies
+#endif
 	while (1) {
-		if (chrono_available) {
-			chrono_available = 0;			//reset the flag
-			tmp = 1234;							//increment tmp
+		//drain the capture ring in one batch and display the latest
+		rec_new = 0;
+		while (chrono_pop(&rec)) {
+			rec_new = 1;
+			//per-record processing goes here
+		}
+		if (rec_new) {
+			tmp = rec.ticks % 10000;			//display rec.ticks, last 4 digits
 			//display tmp
 			//format lRAM[4]
-			lRAM[3]=(tmp % 10) + '0'; tmp /= 10;
-			lRAM[2]=(tmp % 10) + '0'; tmp /= 10;
-			lRAM[1]=(tmp % 10) + '0'; tmp /= 10;
-			lRAM[0]=(tmp % 10) + '0'; tmp /= 10;
+			bcd16(tmp, dig);					//constant time
+			lRAM[3]=dig[4];	//lRAM[] indexes ledfont_num[]
+			lRAM[2]=dig[3];
+			lRAM[1]=dig[2];
+			lRAM[0]=dig[1];
 			//blank leading zero here if you want
-			led_display();						//update the display
+			//the tmr0 isr picks up lRAM[] on its next refresh
 		}	
 		//delay_ms(CHRONO_DLY);				//waste some time
 	}
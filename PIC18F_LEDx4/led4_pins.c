@@ -67,6 +67,7 @@
 
 //global variables
 unsigned char lRAM[4];				//led display buffer
+unsigned char lDP=0;				//decimal points: bit n lights the dp of digit n+1. lRAM[] holds font indices
 //led font.
 //SEGDP = 0x80
 //SEGG   = 0x40
@@ -161,6 +162,7 @@ void led_display(void) {
 	DIG_OFF(DIG4_PORT, DIG4); 
 
 	tmp=ledfont_num[lRAM[dig]];					//retrieve font / segment info from the display buffer
+	if (lDP & (1<<dig)) tmp |= 0x80;			//and the decimal point
 	//turn on/off the segments
 	if (tmp & 0x01) SEG_ON(SEGA_PORT, SEGA); else SEG_OFF(SEGA_PORT, SEGA);
 	if (tmp & 0x02) SEG_ON(SEGB_PORT, SEGB); else SEG_OFF(SEGB_PORT, SEGB);
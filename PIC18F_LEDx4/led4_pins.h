@@ -16,6 +16,7 @@
 
 //global variables
 extern unsigned char lRAM[];							//display buffer, to be provided by the user. 4 digit long
+extern unsigned char lDP;								//decimal points, bit n = digit n+1
 extern const unsigned char ledfont_num[];               //led font for numerical values, '0'..'f', including blanks
 extern const unsigned char ledfont_alpha[];             //led font for alphabeta values, 'a'..'z', including blanks
 
@@ -6,7 +6,9 @@
 #include "gpio.h"                           //we use gpio functions
 #include "delay.h"                          //we use software delays
 #include "led4_pins.h"						//led display routines
-#include "tmr0.h"							//driving led - not used
+#include "bcd.h"							//binary to bcd conversion
+#include "tstamp.h"							//extended time stamps
+#include "tmr0.h"							//driving led
 #include "tmr1.h"							//chrono timer -> configured as systick timer
 
 
@@ -15,60 +17,221 @@
 #define CHRONO_DDR				TRISC		//RC2/CCP1/CHRONO_START, RC1/CCP2/CHRONO_STOP
 #define CHRONO_START			(1<<2)		//RC2/CCP1/CHRONO_START
 #define CHRONO_STOP				(1<<1)		//RC1/CCP2/CHRONO_STOP
-#define CHRONO_TRIGGER			RISING		//chrono-trigger: RISING/FALLING
+#define CHRONO_TRIGGER			RISING		//chrono-trigger: RISING/FALLING - the leading edge of a gate's shadow pulse
+//#define CHRONO_PULSE						//define CHRONO_PULSE to capture the trailing edge of each gate too -> shadow duration / projectile length
+											//projectile must be shorter than the gate distance
+#define CHRONO_PULSE_TOL		4			//start / stop pulse widths differing by more than 1/CHRONO_PULSE_TOL flag a bad trigger: dp on digit 2
+#define CHRONO_DISTANCE			1234		//chrono sensor distance, x10mm (1234=123.4mm) -> projectile length with CHRONO_PULSE
+//#define CHRONO_CAL							//define CHRONO_CAL to measure the ccp1 -> ccp2 skew at boot, by striking both gate pins as outputs. only with sensors that tolerate being overdriven, or disconnected
+#define CHRONO_CAL_N			64			//strikes. power of 2, up to 128
 #define systicks()				(TMR1)		//systicks mapped to TMR1 -> short overflow
 
+#define CHRONO_RING				8			//capture ring size, in records. power of 2, up to 128
+
+#define LED_PS					TMR0_PS_16x	//display refresh: one digit per tmr0 overflow, every 256*16 instructions -> 977Hz/digit, 244Hz/frame@4Mhz F_CPU
+//#define LED_STATS							//define LED_STATS to time the display isr with tmr1 -> led_period / led_busy, read them with the debugger
+//#define CHRONO_BENCH						//define CHRONO_BENCH to time each conversion / bcd strategy with tmr1 at boot -> bench_lo[] / bench_hi[], read them with the debugger. pulls in soft float
+
 #define RISING					0
 #define FALLING					1
 //end hardware configuration
 
+//ccp capture modes
+#define CCP_RISING				0x05		//0b0101->capture on every rising edge
+#define CCP_FALLING				0x04		//0b0100->capture on every falling edge
+#if CHRONO_TRIGGER == RISING
+#define CCP_LEAD				CCP_RISING	//leading edge of a shadow pulse
+#define CCP_TRAIL				CCP_FALLING	//trailing edge of a shadow pulse
+#else
+#define CCP_LEAD				CCP_FALLING
+#define CCP_TRAIL				CCP_RISING
+#endif
+
 //global defines
+//capture record, passed from the isr to the main loop
+typedef struct {
+	uint32_t ticks;							//ticks elapsed between start / end. 268s@16Mhz
+	uint16_t w1, w2;						//start / stop shadow pulse widths, ticks. 0 without CHRONO_PULSE
+} chrono_rec_t;
 
 //global variables
-//volatile uint16_t systicks_msw=0;			//16-bit systick msw
-//volatile uint32_t systicks=0;				//systicks
+volatile uint16_t chrono_msw=0;				//tmr1 overflows: the upper 16 bits of the 32-bit time stamps
 //char lRAM[4];								//display buffer - declared in led4_pins
-volatile uint16_t chrono_ticks=0;
-volatile char chrono_available=0;			//1=new data available in chrono_ticks, 0=no new data
+//single-producer (isr) / single-consumer (main loop) ring of capture records
+//free-running 8-bit indices: chrono_head is written by the isr only, chrono_tail by the main loop only
+volatile chrono_rec_t chrono_ring[CHRONO_RING];	//capture records
+volatile uint8_t chrono_head=0;				//next record to be written by the isr
+volatile uint8_t chrono_tail=0;				//next record to be read by the main loop
+volatile uint8_t chrono_ovf=0;				//records dropped because the ring was full
+int16_t chrono_skew=0;						//ccp2 - ccp1 capture skew, ticks. taken off every elapsed time. set by chrono_cal()
+uint16_t chrono_spread=0;					//skew spread (max - min) over the calibration strikes, ticks. set by chrono_cal()
+#if defined(CHRONO_PULSE)
+uint16_t chrono_lenx10=0;					//projectile length of the last shot, mm x 10. read it with the debugger
+uint8_t chrono_wbad=0;						//shots whose start / stop pulse widths disagree
+#endif
+#if defined(LED_STATS)
+//refresh rate = 16Mhz / (4 * led_period) frames/s; isr duty cycle = led_busy / led_period
+//led_busy covers led_display() only, not the isr entry / exit (~ 20 instructions more)
+volatile uint16_t led_period=0;				//tmr1 ticks between the last two display interrupts. 16384 expected
+volatile uint16_t led_busy=0;				//tmr1 ticks spent in the longest display refresh so far
+#endif
+
+//push a record into the capture ring. called from the isr only. constant time
+//the record is written before chrono_head is advanced, so the main loop never sees a partial record
+void chrono_push(uint32_t ticks, uint16_t w1, uint16_t w2) {
+	uint8_t head = chrono_head;
+
+	if ((uint8_t) (head - chrono_tail) >= CHRONO_RING) {chrono_ovf += 1; return;}	//ring full -> count the loss
+	chrono_ring[head & (CHRONO_RING - 1)].ticks = ticks;
+	chrono_ring[head & (CHRONO_RING - 1)].w1 = w1;
+	chrono_ring[head & (CHRONO_RING - 1)].w2 = w2;
+	chrono_head = head + 1;					//publish the record
+}
+
+//pop a record from the capture ring. called from the main loop only
+//return 1 if a record is retrieved, 0 if the ring is empty
+char chrono_pop(chrono_rec_t *rec) {
+	uint8_t tail = chrono_tail;
+
+	if (tail == chrono_head) return 0;		//ring empty
+	*rec = chrono_ring[tail & (CHRONO_RING - 1)];
+	chrono_tail = tail + 1;					//release the slot
+	return 1;
+}
+
+#if defined(CHRONO_PULSE)
+//convert a shadow pulse width to projectile length, in mm x 10 (mmx10)
+uint32_t ticks2lenx10(uint32_t ticks, uint16_t width) {
+	return ((uint32_t) CHRONO_DISTANCE * width + ticks / 2) / ticks;
+}
+
+//1=the start / stop pulse widths differ by more than 1/CHRONO_PULSE_TOL of the larger one
+//the same projectile shadows both gates: a mismatch means one of the gates triggered on something else
+char chrono_wcheck(chrono_rec_t *rec) {
+	uint16_t wmax = (rec->w1 > rec->w2)?rec->w1:rec->w2;
+	uint16_t wdif = (rec->w1 > rec->w2)?(rec->w1 - rec->w2):(rec->w2 - rec->w1);
+
+	return wdif > wmax / CHRONO_PULSE_TOL;
+}
+#endif
+
+#if defined(CHRONO_BENCH)
+//conversion / bcd benchmark, at boot with interrupts off: tmr1 times each strategy in bench_fns[] over bench_ticks[]
+//bench_lo[] / bench_hi[]: tmr1 ticks per call, less the timing overhead, in bench_fns[] order. tmr1 counts Fosc -> 4 per instruction cycle
+//the memory cost of a strategy (the soft float here) is the difference in the xc8 memory summary of builds with / without it
+#define BENCH_K					(1234ul * 1000 * 16)	//mpsx10 * ticks over 123.4mm, 16 tmr1 ticks per us
+const uint32_t bench_ticks[]={100, 1975, 4000, 19744, 40000, 197440ul, 400000ul, 4000000ul};	//1975 = 1000m/s over 123.4mm@16Mhz
+#define BENCH_N					(sizeof(bench_ticks) / sizeof(bench_ticks[0]))
+volatile uint32_t bench_sink;				//results land here -> not optimized out
+uint8_t bench_dig[BCD32_DIGITS];			//digits land here -> not optimized out
+
+uint32_t bench_nop(uint32_t t) {return t;}	//the timing overhead
+uint32_t bench_fp(uint32_t t) {return (float) BENCH_K / (float) t + 0.5;}	//soft float
+uint32_t bench_div(uint32_t t) {return BENCH_K / t;}	//32-bit integer divide
+uint32_t bench_bcd16(uint32_t t) {bcd16((uint16_t) t, bench_dig); return 0;}
+uint32_t bench_div10(uint32_t t) {			//the divide / modulo loop bcd16() replaced
+	uint16_t v = t;
+	uint8_t i;
+
+	for (i = BCD16_DIGITS; i--; ) {bench_dig[i] = v % 10; v /= 10;}
+	return 0;
+}
+uint32_t bench_bcd32(uint32_t t) {bcd32(t, bench_dig); return 0;}
+
+uint32_t (* const bench_fns[])(uint32_t t)={bench_nop, bench_fp, bench_div, bench_bcd16, bench_div10, bench_bcd32};
+#define BENCH_FNS				(sizeof(bench_fns) / sizeof(bench_fns[0]))
+uint16_t bench_lo[BENCH_FNS], bench_hi[BENCH_FNS];	//fastest / slowest call, tmr1 ticks. [0]: the overhead itself
+
+//tmr1 must be running. leaves TMR1IF clear: the overflows during the benchmark are not time stamps
+void chrono_bench(void) {
+	uint8_t i, j;
+	uint16_t c, t0, lo, hi;
+
+	for (j = 0; j < BENCH_FNS; j++) {
+		lo = 0xffff; hi = 0;
+		for (i = 0; i < BENCH_N; i++) {
+			t0 = TMR1;
+			bench_sink = bench_fns[j](bench_ticks[i]);
+			c = TMR1 - t0 - bench_lo[0];
+			if (c < lo) lo = c;
+			if (c > hi) hi = c;
+		}
+		bench_lo[j] = lo; bench_hi[j] = hi;
+	}
+	TMR1IF = 0;
+}
+#endif
+
+//form the 32-bit time stamp of a captured tmr1 value (CCPR1 / CCPR2). called from the isr only, before TMR1IF is serviced
+//tmr1 may have wrapped around the time of the capture, with TMR1IF still pending and chrono_msw not yet advanced: TS_EXTEND()
+//assumes the isr runs within 0x8000 ticks (2ms@16Mhz) of the capture. host test: test/tstamp_test.c
+uint32_t chrono_stamp(uint16_t ccpr) {
+	return TS_EXTEND((uint32_t) chrono_msw << 16, ccpr, TMR1IF);
+}
 
-//prototypes
-//uint32_t systicks(void);
 //global isr
+//the ccps are serviced before TMR1IF: chrono_stamp() relies on a pending overflow not having been counted yet
+//single vector: TMR1IF is left pending while a capture is, even one that landed after the ccp tests (TS_OVF_DUE())
+//the display refresh goes first: nothing runs between the ccp tests and the TMR1IF test
 void interrupt isr(void) {
-	static uint16_t chrono_start, chrono_stop;
-	//tmr1 isr
-	//if (TMR1IF) {
-	//	TMR1IF = 0;								//clear the flag
-	//	systicks_msw+=1;						//advance the msw
-	//}	
-	
+	static uint32_t chrono_start, chrono_stop;
+	static uint16_t chrono_w1=0;			//start pulse width
+
+	//tmr0 isr - display refresh, one digit per interrupt. not time critical: the captures are latched by the ccps
+	if (TMR0IF) {
+#if defined(LED_STATS)
+		static uint16_t led_prev;
+		uint16_t t0 = TMR1, t1;
+
+		tmr0_isr();							//clear the flag, run led_display()
+		t1 = TMR1;
+		led_period = t0 - led_prev; led_prev = t0;
+		if ((uint16_t) (t1 - t0) > led_busy) led_busy = t1 - t0;
+#else
+		tmr0_isr();							//clear the flag, run led_display()
+#endif
+	}
+
 	//CCP interrupt isr
+	//with CHRONO_PULSE, each ccp alternates between its leading and trailing edge
+	//a ccp mode change can set CCPxIF falsely: change it with CCPxIE off, then clear the flag
 	if (CCP1IF) {
 		CCP1IF = 0;							//clear the flag
-		chrono_start = CCPR1;				//systicks();			//record the timebase
+#if defined(CHRONO_PULSE)
+		if (CCP1CON == CCP_TRAIL) {			//end of the start pulse
+			chrono_w1 = chrono_stamp(CCPR1) - chrono_start;
+			CCP1IE = 0; CCP1CON = CCP_LEAD; CCP1IF = 0; CCP1IE = 1;
+		} else {
+			chrono_start = chrono_stamp(CCPR1);	//record the timebase
+			CCP1IE = 0; CCP1CON = CCP_TRAIL; CCP1IF = 0; CCP1IE = 1;
+		}
+#else
+		chrono_start = chrono_stamp(CCPR1);	//record the timebase
+#endif
 	}
 	
 	if (CCP2IF) {
 		CCP2IF = 0;							//clear the flag
-		chrono_stop = CCPR2;				//systicks();			//record the time base		
-		chrono_ticks = chrono_stop - chrono_start;	//calculate time elapsed
-		chrono_available = 1;				//1=new data available
-	}		
-}
+#if defined(CHRONO_PULSE)
+		if (CCP2CON == CCP_TRAIL) {			//end of the stop pulse -> shot complete
+			chrono_push(chrono_stop - chrono_start - chrono_skew, chrono_w1, chrono_stamp(CCPR2) - chrono_stop);
+			CCP2IE = 0; CCP2CON = CCP_LEAD; CCP2IF = 0; CCP2IE = 1;
+		} else {
+			chrono_stop = chrono_stamp(CCPR2);	//record the time base
+			CCP2IE = 0; CCP2CON = CCP_TRAIL; CCP2IF = 0; CCP2IE = 1;
+		}
+#else
+		chrono_stop = chrono_stamp(CCPR2);	//record the time base
+		chrono_push(chrono_stop - chrono_start - chrono_skew, 0, 0);	//time elapsed, skew compensated, to the main loop
+#endif
+	}
 
-#if 0
-//get systicks
-uint32_t systicks(void) {
-	uint16_t m;								//msw
-	uint16_t f;								//timer count
-	
-	m = systicks_msw;						//read the msw
-	do {
-		f = TMR1;							//read the timer
-	} while (systicks_msw == m);			//make sure that no overflow has taken place / for atomicity
-	return (((uint32_t) m) << 16) | f;
+	//tmr1 isr - last, and not while a capture is pending: the isr runs again for it at once, then for TMR1IF
+	if (TS_OVF_DUE(TMR1IF, CCP1IF || CCP2IF)) {
+		TMR1IF = 0;							//clear the flag
+		chrono_msw += 1;					//advance the msw
+	}
 }
-#endif
 
 //initialize the chrono
 void chrono_init(void) {
@@ -76,33 +239,27 @@ void chrono_init(void) {
 	IO_IN(CHRONO_DDR, CHRONO_START | CHRONO_STOP);
 	
 	//no new data
-	chrono_available = 0;					//no new data available
+	chrono_head = chrono_tail = 0;			//empty the capture ring
+	chrono_ovf = 0;
+	chrono_msw = 0;
 	
 	//set up tmr1
 	tmr1_init(TMR1_PS1x, 0);				//configured as free-running 16-bit timer @ 1x prescaler
 	//tmr1_act(systick_isr);					//systick handler
 	TMR1IF = 0;								//clear the flag
-	TMR1IE = 0;								//tmr1 interrupt off -> max timing is 0xffff* prescaler
+	TMR1IE = 1;								//tmr1 interrupt on -> overflows extend the time stamps to 32 bits. not through tmr1_isr(): it reloads TMR1
 	//tmr1 is now running freely
 	
 	//set up timer capture ccp1/CHRONO_START
 	CCP1IE = 0;								//disable interrupt while being configured
-#if CHRONO_TRIGGER == RISING
-	CCP1CON = 0x05;							//0b0101->rising edge
-#else
-	CCP1CON = 0x04;							//reset ccp1 to falling edge / default
-#endif
+	CCP1CON = CCP_LEAD;						//leading edge, per CHRONO_TRIGGER
 	C1TSEL1=C1TSEL0=0;						//0b00->TIMER1 is the time base for CCP1
 	CCP1IF = 0;								//clear the flag
 	CCP1IE = 1;								//enable ccp1 interrupt
 
 	//set up timer capture ccp2/CHRONO_STOP
 	CCP2IE = 0;								//disable interrupt while being configured
-#if CHRONO_TRIGGER == RISING
-	CCP2CON = 0x05;							//0b0101->rising edge
-#else
-	CCP2CON = 0x04;							//reset ccp1 to falling edge / default
-#endif
+	CCP2CON = CCP_LEAD;						//leading edge, per CHRONO_TRIGGER
 	C2TSEL1=C2TSEL0=0;						//0b00->TIMER1 is the time base for CCP2
 	CCP2IF = 0;								//clear the flag
 	CCP2IE = 1;								//enable ccp2 interrupt
@@ -113,38 +270,104 @@ void chrono_init(void) {
 	PEIE = 1;									//peripheral interrupt on
 }
 
+#if defined(CHRONO_CAL)
+//measure the skew between the ccp1 and ccp2 capture paths
+//both gate pins are driven as outputs and struck in one LATC write, CHRONO_CAL_N times: each strike is a shot with
+//an elapsed time of zero, so its record holds the skew. the mean is taken off every later elapsed time
+//the pins are left as inputs. global interrupts must be on
+void chrono_cal(void) {
+	chrono_rec_t rec;
+	uint8_t i;
+	uint16_t wait;
+	int16_t d, min = 0x7fff, max = -0x7fff;
+	int32_t sum = 0;
+
+	chrono_skew = 0;
+#if CHRONO_TRIGGER == RISING
+	IO_CLR(LATC, CHRONO_START | CHRONO_STOP);	//idle low
+#else
+	IO_SET(LATC, CHRONO_START | CHRONO_STOP);	//idle high
+#endif
+	IO_OUT(CHRONO_DDR, CHRONO_START | CHRONO_STOP);
+	for (i = 0; i < CHRONO_CAL_N; i++) {
+		delay_us(100);						//settle
+		IO_FLP(LATC, CHRONO_START | CHRONO_STOP);	//strike both channels: the leading edge
+		delay_us(10);
+		IO_FLP(LATC, CHRONO_START | CHRONO_STOP);	//back to idle: the trailing edge, for CHRONO_PULSE
+		for (wait = 0; !chrono_pop(&rec) && (wait < 1000); wait++) continue;	//wait for the record
+		if (wait == 1000) break;			//no capture -> calibration failed, no compensation
+		d = (int16_t) rec.ticks;
+		sum += d;
+		if (d < min) min = d;
+		if (d > max) max = d;
+	}
+	IO_IN(CHRONO_DDR, CHRONO_START | CHRONO_STOP);
+	delay_us(100);
+
+	if (i == CHRONO_CAL_N) {
+		chrono_skew = (sum + ((sum < 0) ? -CHRONO_CAL_N / 2 : CHRONO_CAL_N / 2)) / CHRONO_CAL_N;	//mean, rounded
+		chrono_spread = max - min;
+	}
+	//discard anything left from the strikes
+	di(); chrono_head = chrono_tail = 0; chrono_ovf = 0; ei();
+}
+#endif
+
+//set up the periodic display refresh on tmr0
+void led_refresh(void) {
+	tmr0_init(LED_PS);						//tmr0 counts Fosc/4 through the prescaler
+	T08BIT = 1;								//8-bit mode -> overflows every 256 counts
+	TMR0ON = 1;								//run tmr0
+	tmr0_act(led_display);					//led_display() runs from the tmr0 isr
+}
+
 int main(void) {
 	uint16_t cnt=0,tmp;							//4-digit display variable
+	uint8_t dig[BCD16_DIGITS];					//digits of tmp, most significant first
 	uint16_t tmr1_prev=0, tmr1_sec=0;;
+	chrono_rec_t rec;							//capture record
+	char rec_new;								//1=new records drained this pass
+	char rec_bad=0;								//1=the latest record's pulse widths disagree
 	
 	mcu_init();							   		 //initialize the mcu, 16Mhz
 	
 	//set up led display
 	led_init();									//reset the led
+	led_refresh();								//refresh the led from the tmr0 isr
 	chrono_init();								//reset the chrono
+#if defined(CHRONO_BENCH)
+	chrono_bench();								//before interrupts are on: nothing else takes cycles
+#endif
 	
 	ei();										//enable global interrupts
+#if defined(CHRONO_CAL)
+	//if chrono_start/stop are configured as output pins, a transition on them will trigger a capture, per the datasheet
+	chrono_cal();								//measure the ccp1 -> ccp2 skew
+#endif
 	while (1) {
-		//if chrono_start/stop are configured as output pins, a transition on them will trigger a capture, per the datasheet
-#if 0
-		IO_OUT(CHRONO_DDR, CHRONO_START | CHRONO_STOP);
-		IO_FLP(LATC, CHRONO_START); IO_FLP(LATC, CHRONO_START);	//strike chrono_start -> start capture should take place here
-		//do something here
-		delay_us(100/8);						//12.5=700, 25=1220, 50=2220, 100=4220, 200=8220
-		IO_FLP(LATC, CHRONO_STOP); IO_FLP(LATC, CHRONO_STOP);	//strike chrono_start -> start capture should take place here
+		//new records should be in the capture ring. drain it in one batch and display the latest
+		rec_new = 0;
+		while (chrono_pop(&rec)) {
+			rec_new = 1;
+			//per-record processing goes here
+#if defined(CHRONO_PULSE)
+			rec_bad = chrono_wcheck(&rec);
+			if (rec_bad) chrono_wbad += 1;
+			chrono_lenx10 = ticks2lenx10(rec.ticks, ((uint32_t) rec.w1 + rec.w2) / 2);
 #endif
-		//chrono_available should be set, and elapsed time captured in chrono_ticks
-		if (chrono_available) {					//if new data is available, display it
-			chrono_available = 0;				//reset the flag
-			tmp = chrono_ticks/1;					//display chrono_ticks
+		}
+		if (rec_new) {							//if new data is available, display it
+			tmp = rec.ticks % 10000;			//display rec.ticks, last 4 digits
 			//display tmp
 			//format lRAM[4]
-			lRAM[3]=(tmp % 10) + 0; tmp /= 10;
-			lRAM[2]=(tmp % 10) + 0; tmp /= 10;
-			lRAM[1]=(tmp % 10) + 0; tmp /= 10;
-			lRAM[0]=(tmp % 10) + 0; tmp /= 10;
+			bcd16(tmp, dig);					//constant time
+			lRAM[3]=dig[4];
+			lRAM[2]=dig[3];
+			lRAM[1]=dig[2];
+			lRAM[0]=dig[1];
+			lDP = (rec_bad)?0x02:0x00;			//dp on digit 2: suspect trigger
 			//blank leading zero here if you want
-			led_display();						//update the display
+			//the tmr0 isr picks up lRAM[] on its next refresh
 		}	
 		//delay_ms(CHRONO_DLY);					//waste some time
 	}
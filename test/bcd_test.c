@@ -0,0 +1,47 @@
+//host test of bcd16() / bcd32() (bcd.c): every 16-bit value, and the 32-bit values around each power of 10 plus a
+//pseudo-random sweep, against digits taken off by repeated division
+//build with the target's bcd.c, e.g. gcc -I../ATmega8 bcd_test.c ../ATmega8/bcd.c (see Makefile)
+#include <stdio.h>
+#include <stdint.h>
+#include "bcd.h"
+
+static unsigned long checks=0, fails=0;
+
+//compare n digits of val, most significant first, with dig[]
+static void check(uint32_t val, const uint8_t *dig, int n) {
+	uint32_t v = val;
+	int i;
+
+	checks += 1;
+	for (i = n - 1; i >= 0; i--, v /= 10)
+		if (dig[i] != v % 10) {
+			if (fails++ < 10) printf("bcd%d: %lu wrong at digit %d\n", (n == BCD16_DIGITS)?16:32, (unsigned long) val, i);
+			return;
+		}
+}
+
+static void check32(uint32_t val) {
+	uint8_t dig[BCD32_DIGITS];
+
+	bcd32(val, dig);
+	check(val, dig, BCD32_DIGITS);
+}
+
+int main(void) {
+	uint8_t dig[BCD16_DIGITS];
+	uint32_t p, x=12345;
+	long i;
+	int d;
+
+	for (i = 0; i < 0x10000l; i++) {bcd16(i, dig); check(i, dig, BCD16_DIGITS);}	//every 16-bit value
+	for (p = 1, i = 0; i < 10; i++, p *= 10)		//around each power of 10, and each run of 9s
+		for (d = -2; d <= 2; d++) check32(p + d);
+	check32(0xfffffffful); check32(0xfffffffful - 1);
+	for (i = 0; i < 2000000l; i++) {				//xorshift32: the whole range, every digit count
+		x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+		check32(x);
+		check32(x >> (x & 31));
+	}
+	printf("bcd: %lu checks, %lu failures\n", checks, fails);
+	return fails?1:0;
+}
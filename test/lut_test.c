@@ -0,0 +1,30 @@
+//host test of the CHRONO_LUT table (ATmega8 lut.h): every 1x tick count in the table's range, against exact division
+//the table is built for F_CPU / CHRONO_DISTANCE as compiled -> -DF_CPU=4000000ul -DCHRONO_DISTANCE=1234 (see Makefile)
+//limit, as documented in lut.h: at most 1 count + 0.023% of mpsx10
+#include <stdio.h>
+#include <stdint.h>
+
+#define PROGMEM								//flash is plain memory on the host
+#define pgm_read_word(p)		(*(const uint16_t *) (p))
+#include "lut.h"
+
+#define LUT_TOL					0.00023		//relative part of the limit
+
+int main(void) {
+	unsigned long checks=0, fails=0;
+	double exact, err, worst=0;
+	uint32_t t;
+
+	for (t = LUT_TMIN; t < LUT_TMAX; t++) {
+		exact = (double) LUT_K / t;
+		err = lut_ticks2mpsx10(t) - exact;
+		if (err < 0) err = -err;
+		if ((err - 1) / exact > worst) worst = (err - 1) / exact;
+		checks += 1;
+		if (err > 1 + LUT_TOL * exact) {
+			if (fails++ < 10) printf("fail: %lu ticks -> %u, exact %.2f\n", (unsigned long) t, lut_ticks2mpsx10(t), exact);
+		}
+	}
+	printf("lut %luhz d%u: %lu checks, %lu failures, worst %.4f%% past 1 count\n", (unsigned long) F_CPU, CHRONO_DISTANCE, checks, fails, worst * 100);
+	return fails?1:0;
+}
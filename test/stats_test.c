@@ -0,0 +1,72 @@
+//host test of stats.c (shot-string statistics): strings of 1..STATS_NMAX shots against a double reference
+//mean and sample sd off the whole string in double, min / max / es exact
+//limits: mean within 0.5 + the rounding of the running mean, n / 4 counts of Q(STATS_Q); sd within 0.5 + STATS_SD_TOL
+//-I picks the target's stats.h
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include "stats.h"
+
+#define STATS_SD_TOL			0.02			//counts past the rounding of the sd: the rounded running mean in m2
+
+static unsigned long checks=0, fails=0;
+static double worst_m=0, worst_s=0;
+static uint32_t seed=2463534242ul;
+
+static uint32_t xorshift(void) {
+	seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+	return seed;
+}
+
+//one string of n shots: base + a spread, the spread drawn per shot
+static void string(uint8_t n, uint32_t base, uint32_t spread) {
+	stats_t s;
+	uint32_t x[STATS_NMAX], lo, hi;
+	double sum=0, ss=0, mean, sd, err, lim;
+	int i;
+
+	stats_reset(&s);
+	for (i = 0; i < n; i++) {
+		x[i] = base + (spread?(xorshift() % (spread + 1)):0);
+		if (x[i] > STATS_XMAX) x[i] = STATS_XMAX;
+		stats_add(&s, x[i]);
+		sum += x[i];
+	}
+	mean = sum / n;
+	lo = hi = x[0];
+	for (i = 0; i < n; i++) {
+		ss += (x[i] - mean) * (x[i] - mean);
+		if (x[i] < lo) lo = x[i];
+		if (x[i] > hi) hi = x[i];
+	}
+	sd = (n > 1)?sqrt(ss / (n - 1)):0;
+	checks += 1;
+	err = fabs(stats_mean(&s) - mean);
+	lim = 0.5 + n / 4.0 / (1 << STATS_Q);
+	if (err - 0.5 > worst_m) worst_m = err - 0.5;
+	if (err > lim) {
+		if (fails++ < 10) printf("fail: n %u, base %lu spread %lu -> mean %lu, exact %.3f\n", n, (unsigned long) base, (unsigned long) spread, (unsigned long) stats_mean(&s), mean);
+	}
+	err = fabs(stats_sd(&s) - sd);
+	if (err - 0.5 > worst_s) worst_s = err - 0.5;
+	if (err > 0.5 + STATS_SD_TOL) {
+		if (fails++ < 10) printf("fail: n %u, base %lu spread %lu -> sd %lu, exact %.3f\n", n, (unsigned long) base, (unsigned long) spread, (unsigned long) stats_sd(&s), sd);
+	}
+	if ((s.n != n) || (s.min != lo) || (s.max != hi) || (stats_es(&s) != hi - lo)) {
+		if (fails++ < 10) printf("fail: n %u, base %lu spread %lu -> n %u lo %lu hi %lu\n", n, (unsigned long) base, (unsigned long) spread, s.n, (unsigned long) s.min, (unsigned long) s.max);
+	}
+}
+
+int main(void) {
+	static const uint32_t bases[]={0, 1, 500, 3000, 9000, 15000, 65535, STATS_XMAX / 2, STATS_XMAX};
+	static const uint32_t spreads[]={0, 1, 2, 10, 100, 1000, 10000, STATS_XMAX};
+	unsigned i, j, k;
+	unsigned n;
+
+	for (i = 0; i < sizeof(bases) / sizeof(bases[0]); i++)
+		for (j = 0; j < sizeof(spreads) / sizeof(spreads[0]); j++)
+			for (n = 1; n <= STATS_NMAX; n++)
+				for (k = 0; k < 4; k++) string(n, bases[i], spreads[j]);
+	printf("stats: %lu strings, %lu failures, worst mean %.3f / sd %.3f past 0.5\n", checks, fails, worst_m, worst_s);
+	return fails?1:0;
+}
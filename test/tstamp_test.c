@@ -0,0 +1,110 @@
+//host test of TS_EXTEND() (tstamp.h): the pending-overflow fix-up of the extended time stamps
+//every capture phase (all 65536 values of the 16-bit capture) around a timer wrap and around the wrap of the time
+//stamp itself, for capture isr latencies up to 0x7fff counts, with the overflow isr serviced or still pending.
+//the extended count must equal the true time of the capture and step by exactly 1 from one capture phase to the next
+//-I picks the target's tstamp.h. -DCHRONO_TS48 for the 48-bit time stamps of the ATmega8 build
+//with TS_OVF_DUE() (PIC18): the single-vector isr, a capture landing anywhere in a pass, the timer wrapping before
+//its overflow test
+#include <stdio.h>
+#include <stdint.h>
+#include "tstamp.h"
+
+#if defined(CHRONO_TS48)
+typedef uint64_t ts_t;
+#define TS_MASK					0xffffffffffffull	//48-bit time stamps
+#else
+typedef uint32_t ts_t;
+#define TS_MASK					0xfffffffful		//32-bit time stamps
+#endif
+
+static unsigned long checks=0, fails=0;
+
+//the extended count the isr forms for a capture at time t, with the isr running lat counts later
+//held=1: the overflow isr has not run since the last wrap (held off by another isr) -> TOV still pending
+//the capture isr outranks the overflow isr: a wrap between the capture and the capture isr is always pending
+static ts_t stamp(ts_t t, uint32_t lat, int held) {
+	ts_t r = (t + lat) & TS_MASK;			//the capture isr runs
+	ts_t w = r & ~(ts_t) 0xffff;			//last wrap at or before r
+	ts_t msw = w;							//overflow count the isr reads
+	int tov = 0;							//overflow flag the isr reads
+
+	if (((t & ~(ts_t) 0xffff) != w) || held) {msw = (w - 0x10000) & TS_MASK; tov = 1;}
+	return TS_EXTEND(msw, (uint16_t) (t & 0xffff), tov) & TS_MASK;
+}
+
+static void sweep(ts_t base) {
+	static const uint32_t lats[]={0, 1, 2, 3, 0x10, 0xff, 0x100, 0x1000, 0x4000, 0x7ffe, 0x7fff};
+	ts_t t, got, prev;
+	uint32_t lat;
+	int i, held;
+
+	for (i = 0; i < (int) (sizeof(lats) / sizeof(lats[0])); i++)
+		for (held = 0; held < 2; held++) {
+			lat = lats[i];
+			prev = 0;
+			for (t = (base - 0x10000) & TS_MASK; t != ((base + 0x10000) & TS_MASK); t = (t + 1) & TS_MASK) {
+				//a held overflow isr: only while the isr is within 0x8000 counts of the wrap it holds off
+				if (held && ((((t + lat) & 0xffff)) >= 0x8000)) {prev = 0; continue;}
+				got = stamp(t, lat, held);
+				checks += 1;
+				if ((got != t) || (prev && (((got - prev) & TS_MASK) != 1))) {
+					if (fails++ < 10) printf("fail: t=%llx lat=%x held=%d -> %llx\n", (unsigned long long) t, lat, held, (unsigned long long) got);
+				}
+				prev = got;
+			}
+		}
+}
+
+#if defined(TS_OVF_DUE)
+//single-vector isr: each pass tests the capture flag at time c, then the overflow flag d counts later. passes follow
+//each other e counts apart while a flag is pending. the capture at time t and the wrap at w set their flags as time
+//passes them, whether or not a pass is under way
+static void single(ts_t w) {
+	static const uint32_t ds[]={0, 1, 2, 16, 100, 0x400}, es[]={1, 10};
+	ts_t t, c, s, msw, got;
+	int i, j, n, cap, tov, done, capd, wrapd;
+
+	for (i = 0; i < (int) (sizeof(ds) / sizeof(ds[0])); i++)
+		for (j = 0; j < (int) (sizeof(es) / sizeof(es[0])); j++)
+			for (t = w - 0x200; t != w + 0x200; t++)
+				for (s = t - ds[i] - 1; s != t + 1; s++) {	//the first pass starts up to a pass before the capture
+					msw = (w - 0x10000) & TS_MASK;
+					cap = tov = done = capd = wrapd = 0;
+					got = 0;
+					c = s;
+					for (n = 0; n < 8; n++) {
+						if (!capd && (c >= t)) {capd = cap = 1;}
+						if (!wrapd && (c >= w)) {wrapd = tov = 1;}
+						if (cap) {got = TS_EXTEND(msw, (uint16_t) (t & 0xffff), tov) & TS_MASK; cap = 0; done = 1;}
+						c += ds[i];					//the rest of the pass
+						if (!capd && (c >= t)) {capd = cap = 1;}
+						if (!wrapd && (c >= w)) {wrapd = tov = 1;}
+						if (TS_OVF_DUE(tov, cap)) {tov = 0; msw = (msw + 0x10000) & TS_MASK;}
+						if (done && !cap && !tov && wrapd) break;
+						c += es[j];
+					}
+					checks += 1;
+					if ((got != (t & TS_MASK)) || !done) {
+						if (fails++ < 10) printf("fail: single vector, t=%llx pass at %llx d=%x -> %llx\n", (unsigned long long) t, (unsigned long long) s, ds[i], (unsigned long long) got);
+					}
+				}
+}
+#endif
+
+int main(void) {
+	sweep(0x10000);							//first wrap
+	sweep(0x7fff0000ul);
+	sweep(0x80000000ul);
+	sweep(0xffff0000ul);					//the 32-bit time stamp wraps here; the 48-bit one carries into bit 32
+#if defined(CHRONO_TS48)
+	sweep(0x7fffffff0000ull);
+	sweep(0xffffffff0000ull);				//the 48-bit time stamp wraps here
+#endif
+	sweep(0);								//time stamp wrap, from the other side
+#if defined(TS_OVF_DUE)
+	single(0x10000);
+	single(0x80000000ul);
+#endif
+	printf("tstamp: %lu checks, %lu failures\n", checks, fails);
+	return fails?1:0;
+}
@@ -0,0 +1,80 @@
+//host test of the velocity pipeline (vq.h of each target): VQ_SHIFT() / VQ_ROUND() / VQ_FPSX10() against exact division
+//for each clock and sensor distance, cfg_apply()'s distance constant k and a tick sweep from 50 to 5e7 1x ticks
+//limit: the divide truncates vq by < 2^-sh of a count -> mpsx10 within 0.5 + 2^-sh, fpsx10 within 0.5 + 3.28084 * 2^-sh (+ KFPS_Q24 rounding)
+//energy / pf for a few masses, against the constants as scaled (KE_x / 2^KE_SH, KPF_PFX10 / 2^KPF_SH) at the exact velocity:
+//within 0.5 + 1/32 (VQ_ENERGY()'s cut) + the vq truncation, 2 * 2^-sh of mpsx10 for energy, 2^-VQ_PFSH(sh) for pf
+#include <stdio.h>
+#include <stdint.h>
+#include "vq.h"
+
+#define KFPS					3.28084		//ft/s per m/s
+#define KFPS_TOL				1e-8		//relative: KFPS_Q24 is 3.28084 * 2^24 rounded
+
+int main(void) {
+	const uint32_t fcpu[]={1000000ul, 4000000ul, 8000000ul, 16000000ul};
+	const uint16_t dist[]={1, 50, 500, 1234, 2000, 3000, 10000, 65535};	//mm x 10, cfg.distance
+	const uint16_t mass[]={1, 10, 1470, 65535};	//grains x 10, cfg.mass
+	unsigned long checks=0, fails=0;
+	uint32_t k, kq, t, vq, m, f, e;
+	uint8_t sh;
+	double exact, v, lim, err;
+	unsigned i, j, g;
+
+	for (i = 0; i < sizeof(fcpu) / sizeof(fcpu[0]); i++)
+		for (j = 0; j < sizeof(dist) / sizeof(dist[0]); j++) {
+			k = (uint32_t) dist[j] * 1000ul * (fcpu[i] / 1000000ul);	//as cfg_apply()
+			VQ_SHIFT(sh, k);
+			kq = k << sh;
+			if ((sh < 1) || (sh > 16) || ((kq >> sh) != k) || ((sh < 16) && ((k >> (31 - sh)) == 0))) {
+				if (fails++ < 10) printf("fail: k %lu -> shift %u\n", (unsigned long) k, sh);
+				continue;					//shift out of range, k << sh overflows or a larger shift would have fit
+			}
+			for (t = 50; t <= 50000000ul; t += t / 97 + 1) {
+				vq = kq / t;
+				m = VQ_ROUND(vq, sh);
+				f = VQ_FPSX10(vq, sh);
+				exact = (double) k / t;
+				lim = 0.5 + 1.0 / (1ul << sh);
+				err = m - exact;
+				if (err < 0) err = -err;
+				if (err > lim) {
+					if (fails++ < 10) printf("fail: k %lu, %lu ticks -> mpsx10 %lu, exact %.3f\n", (unsigned long) k, (unsigned long) t, (unsigned long) m, exact);
+				}
+				exact *= KFPS;
+				err = f - exact;
+				if (err < 0) err = -err;
+				if (err > 0.5 + KFPS / (1ul << sh) + KFPS_TOL * exact) {
+					if (fails++ < 10) printf("fail: k %lu, %lu ticks -> fpsx10 %lu, exact %.3f\n", (unsigned long) k, (unsigned long) t, (unsigned long) f, exact);
+				}
+				checks += 2;
+				if (exact / KFPS > 0xffff) continue;	//energy / pf: mpsx10 up to 0xffff, clamped before
+				v = exact / KFPS;
+				for (g = 0; g < sizeof(mass) / sizeof(mass[0]); g++) {
+					e = VQ_ENERGY(vq, sh, mass[g], KE_JX10);
+					exact = mass[g] * v * v * KE_JX10 / (double) (1ull << KE_SH);
+					err = e - exact;
+					if (err < 0) err = -err;
+					if (err > 0.5 + 1.0 / 32 + 2 * exact / v / (1ul << sh)) {
+						if (fails++ < 10) printf("fail: k %lu, %lu ticks, %ugrx10 -> jx10 %lu, exact %.3f\n", (unsigned long) k, (unsigned long) t, mass[g], (unsigned long) e, exact);
+					}
+					e = VQ_ENERGY(vq, sh, mass[g], KE_FTLBFX10);
+					exact = mass[g] * v * v * KE_FTLBFX10 / (double) (1ull << KE_SH);
+					err = e - exact;
+					if (err < 0) err = -err;
+					if (err > 0.5 + 1.0 / 32 + 2 * exact / v / (1ul << sh)) {
+						if (fails++ < 10) printf("fail: k %lu, %lu ticks, %ugrx10 -> ftlbfx10 %lu, exact %.3f\n", (unsigned long) k, (unsigned long) t, mass[g], (unsigned long) e, exact);
+					}
+					e = VQ_PFX10(vq, sh, mass[g]);
+					exact = mass[g] * v * KPF_PFX10 / (double) (1ull << KPF_SH);
+					err = e - exact;
+					if (err < 0) err = -err;
+					if (err > 0.5 + 2 * exact / v / (1ul << VQ_PFSH(sh))) {
+						if (fails++ < 10) printf("fail: k %lu, %lu ticks, %ugrx10 -> pfx10 %lu, exact %.3f\n", (unsigned long) k, (unsigned long) t, mass[g], (unsigned long) e, exact);
+					}
+					checks += 3;
+				}
+			}
+		}
+	printf("vq: %lu checks, %lu failures\n", checks, fails);
+	return fails?1:0;
+}